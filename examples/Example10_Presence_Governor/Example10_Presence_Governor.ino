@@ -0,0 +1,86 @@
+/*
+  Low power heart rate: only run the LEDs at full power when a finger is present
+  SparkFun Electronics
+
+  The sensor waits in proximity mode with only the pilot LED pulsing at a low current.
+  When something comes close the part switches to full acquisition by itself and we
+  start looking for beats. When the finger is removed it goes back to waiting.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected (connect it and only call governor.update() when it is low to save more)
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "heartRate.h"
+#include "presenceGovernor.h"
+
+MAX30105 particleSensor;
+PresenceGovernor governor;
+BeatDetector detector;
+
+long lastBeat = 0; //Time at which the last beat occurred
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  particleSensor.setup(); //Full acquisition settings, used once a finger is found
+
+  //Wait in proximity mode until the IR count passes 0x20 << 10 (32768)
+  governor.begin(particleSensor, GOVERNOR_PROXIMITY, 0x20);
+  //Or: governor.begin(particleSensor, GOVERNOR_DUTY_CYCLE, 0x20); to sleep and look once a second
+
+  Serial.println("Waiting for a finger");
+}
+
+void loop()
+{
+  governor.update();
+
+  if (governor.presenceChanged())
+  {
+    if (governor.active())
+    {
+      Serial.println("Finger found");
+      detector = BeatDetector(); //Start over
+    }
+    else
+      Serial.println("Finger removed, waiting");
+  }
+
+  if (governor.active() == false) return; //Nothing to read
+
+  particleSensor.check();
+  while (particleSensor.available())
+  {
+    uint32_t irValue = particleSensor.getFIFOIR();
+    particleSensor.nextSample();
+
+    governor.sample(irValue);
+
+    if (checkForBeat(detector, irValue) == true)
+    {
+      long delta = millis() - lastBeat;
+      lastBeat = millis();
+
+      Serial.print("BPM=");
+      Serial.println(60 / (delta / 1000.0));
+    }
+  }
+}
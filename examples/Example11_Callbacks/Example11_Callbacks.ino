@@ -0,0 +1,80 @@
+/*
+  Heart rate and SpO2 through callbacks
+  SparkFun Electronics
+
+  Rather than polling for samples and passing each one to checkForBeat(), a PulseMonitor
+  is attached to the sensor. Every check() hands the new samples to it and it calls
+  back when it finds a beat and once a second with a new SpO2 reading.
+
+  The callbacks run inside check(), so they are free to print. That only holds because check()
+  is called from loop(). Don't call it from an interrupt while callbacks are set.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+#include "pulseMonitor.h"
+
+MAX30105 particleSensor;
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+//Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
+PulseMonitor<25, 100, uint16_t> monitor;
+#else
+PulseMonitor<> monitor;
+#endif
+
+void beatFound(uint16_t ibiMillis, void *context)
+{
+  if (ibiMillis == 0) return; //First beat, no interval yet
+
+  Serial.print(F("IBI="));
+  Serial.print(ibiMillis);
+  Serial.print(F("ms, BPM="));
+  Serial.println(60000.0 / ibiMillis);
+}
+
+void spo2Ready(const SpO2Reading &reading, void *context)
+{
+  Serial.print(F("SPO2="));
+  Serial.print(reading.spo2);
+  Serial.print(F(", SPO2Valid="));
+  Serial.print(reading.spo2Valid);
+  Serial.print(F(", HR="));
+  Serial.print(reading.heartRate);
+  Serial.print(F(", HRValid="));
+  Serial.println(reading.heartRateValid);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println(F("Initializing..."));
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println(F("MAX30105 was not found. Please check wiring/power."));
+    while (1);
+  }
+
+  //Same settings as Example8_SPO2: 100 samples per second averaged by 4 gives 25 per second
+  particleSensor.setup(60, 4, 2, 100, 411, 4096);
+
+  monitor.begin(particleSensor);
+  monitor.onBeat(beatFound);
+  monitor.onSpO2(spo2Ready);
+}
+
+void loop()
+{
+  particleSensor.check(); //Callbacks are made from in here
+}
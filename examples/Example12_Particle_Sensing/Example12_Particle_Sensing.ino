@@ -0,0 +1,70 @@
+/*
+  Particle sensing at 3200 samples per second
+  SparkFun Electronics
+
+  Shows how to count particles (dust, smoke, fibers) passing in front of the sensor. The
+  ParticleDetector follows the background IR count and its noise, and reports every short
+  burst of scattered light that stands out from it.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+#include "particleDetector.h"
+
+MAX30105 particleSensor;
+ParticleDetector detector(PARTICLE_IR_MASK);
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("MAX30105 Particle Sensing Example");
+
+  if (particleSensor.begin(Wire, I2C_SPEED_FAST) == false) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  byte ledBrightness = 0xFF; //Options: 0=Off to 255=50mA
+  byte sampleAverage = 1; //Options: 1, 2, 4, 8, 16, 32
+  byte ledMode = 2; //Options: 1 = Red only, 2 = Red + IR, 3 = Red + IR + Green
+  int sampleRate = 3200; //Options: 50, 100, 200, 400, 800, 1000, 1600, 3200
+  int pulseWidth = 69; //Options: 69, 118, 215, 411. Only 69 allows 3200 samples per second.
+  int adcRange = 2048; //Options: 2048, 4096, 8192, 16384
+
+  particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
+  particleSensor.setPulseAmplitudeRed(0); //Only IR is used
+
+  detector.setThreshold(24, 20); //6x the background noise plus 20 counts
+  detector.setDebounce(2, 4); //2 samples to start an event, 4 to end it
+  detector.begin(particleSensor); //check() now feeds the detector
+}
+
+void loop()
+{
+  particleSensor.check(); //Keep reading the FIFO, the detector runs from in here
+
+  ParticleEvent event;
+  while (detector.nextEvent(event))
+  {
+    Serial.print("Particle at sample ");
+    Serial.print(event.sample);
+    Serial.print(" duration[");
+    Serial.print(event.duration);
+    Serial.print("] peak[");
+    Serial.print(event.peak);
+    Serial.print("] total[");
+    Serial.print(detector.getCount(PARTICLE_IR));
+    Serial.println("]");
+  }
+}
@@ -0,0 +1,59 @@
+/*
+  Stream every sample to a computer in binary
+  SparkFun Electronics
+
+  Printing each reading as text can't keep up with the higher sample rates (see
+  Example9_RateTesting). This sends the samples as small CRC checked packets instead,
+  about 3.5 bytes a sample for Red+IR. Decode them on the computer with
+  SampleStreamDecoder, feeding it the bytes read from the serial port. It only needs
+  sampleStreamDecoder.h and sampleStreamDecoder.cpp, so any C++ compiler will build it.
+
+  The output is binary so the Serial Monitor will show garbage.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+#include "sampleStream.h"
+
+MAX30105 particleSensor;
+SampleStreamEncoder encoder;
+
+void setup()
+{
+  Serial.begin(115200);
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  byte ledBrightness = 0x1F; //Options: 0=Off to 255=50mA
+  byte sampleAverage = 1; //Options: 1, 2, 4, 8, 16, 32
+  byte ledMode = 2; //Options: 1 = Red only, 2 = Red + IR, 3 = Red + IR + Green
+  int sampleRate = 400; //Options: 50, 100, 200, 400, 800, 1000, 1600, 3200
+  int pulseWidth = 411; //Options: 69, 118, 215, 411
+  int adcRange = 4096; //Options: 2048, 4096, 8192, 16384
+
+  particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
+
+  encoder.begin(Serial);
+  encoder.setConfig(sampleRate, sampleAverage, pulseWidth, adcRange); //Sent in every packet header
+  encoder.setSamplesPerPacket(40); //10 packets a second
+  encoder.attach(particleSensor); //check() now hands every sample to the encoder
+}
+
+void loop()
+{
+  particleSensor.check(); //Nothing else to do, packets are written as they fill
+}
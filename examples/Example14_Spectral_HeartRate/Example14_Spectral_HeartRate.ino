@@ -0,0 +1,91 @@
+/*
+  Heart rate from the pulse's frequency instead of timing each beat
+  SparkFun Electronics
+
+  Example5_HeartRate times the gap between beats, so a missed or doubled beat gives a
+  wrong rate until the average catches up. This example runs that beat detector and
+  SpectralHeartRate side by side. The spectral estimate looks at the last ~10 seconds
+  and reports the strongest rhythm between 30 and 240bpm with a confidence.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "heartRate.h"
+#include "ppgChannel.h"
+#include "spectralHeartRate.h"
+
+MAX30105 particleSensor;
+
+PPGChannel irChannel(25); //Shared DC removal and filtering for both estimators
+BeatDetector detector;
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+SpectralHeartRate<25, 128> spectral; //5 seconds, less resolution but fits in the Uno's RAM
+#else
+SpectralHeartRate<25, 256> spectral; //About 10 seconds of samples
+#endif
+
+long lastBeat = 0; //Time at which the last beat occurred
+float beatsPerMinute;
+byte samples = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+  Serial.println("Place your index finger on the sensor with steady pressure.");
+
+  //100 samples per second averaged by 4 gives the 25 samples per second the estimators expect
+  particleSensor.setup(0x1F, 4, 2, 100, 411, 4096);
+}
+
+void loop()
+{
+  particleSensor.check(); //Check the sensor, read up to 3 samples
+
+  while (particleSensor.available())
+  {
+    irChannel.update(particleSensor.getFIFOIR());
+    spectral.update(irChannel);
+
+    if (checkForBeat(detector, irChannel) == true)
+    {
+      long delta = millis() - lastBeat;
+      lastBeat = millis();
+      beatsPerMinute = 60 / (delta / 1000.0);
+    }
+
+    particleSensor.nextSample();
+
+    //Report once a second
+    if (++samples < 25) continue;
+    samples = 0;
+
+    Serial.print("Beat BPM=");
+    Serial.print(beatsPerMinute);
+    Serial.print(", Spectral BPM=");
+    if (spectral.isValid())
+      Serial.print(spectral.getHeartRate());
+    else
+      Serial.print("--");
+    Serial.print(", Confidence=");
+    Serial.print(spectral.getConfidence());
+    Serial.println("%");
+  }
+}
@@ -0,0 +1,81 @@
+/*
+  Checking a sensor configuration before using it
+  SparkFun Electronics
+
+  setup() takes any powerLevel, sampleAverage, sampleRate and pulseWidth, but some
+  combinations are more than the part can sample or the I2C bus can carry. This example
+  refuses to compile with a configuration that won't work, then prints what it costs:
+  LED current, bus traffic, and how long loop() can go without calling check().
+
+  Change the settings below and recompile to compare them.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "sensorBudget.h"
+
+#define POWER_LEVEL 0x1F //6.2mA
+#define SAMPLE_AVERAGE 4
+#define LED_MODE 2 //Red and IR
+#define SAMPLE_RATE 400
+#define PULSE_WIDTH 411
+#define ADC_RANGE 4096
+#define CHECK_MILLIS 20 //How often loop() calls check()
+
+constexpr SensorBudget budget(POWER_LEVEL, SAMPLE_AVERAGE, LED_MODE, SAMPLE_RATE, PULSE_WIDTH, I2C_SPEED_FAST, CHECK_MILLIS);
+static_assert(budget.feasible(), "This configuration can't be sampled or read fast enough, see feasibility()");
+
+MAX30105 particleSensor;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  Serial.print("LED average current uA: ");
+  Serial.println(budget.ledChargePerSecond());
+  Serial.print("I2C bytes per second: ");
+  Serial.println(budget.busBytesPerSecond());
+  Serial.print("Slowest I2C clock Hz: ");
+  Serial.println(budget.minBusClock());
+  Serial.print("FIFO fills in us: ");
+  Serial.println(budget.fifoFillMicros());
+  Serial.print("Longest gap between check() calls us: ");
+  Serial.println(budget.maxServiceLatencyMicros());
+
+  particleSensor.setup(POWER_LEVEL, SAMPLE_AVERAGE, LED_MODE, SAMPLE_RATE, PULSE_WIDTH, ADC_RANGE);
+}
+
+void loop()
+{
+  particleSensor.check(); //Read whatever the FIFO holds
+
+  while (particleSensor.available())
+  {
+    Serial.print("R[");
+    Serial.print(particleSensor.getFIFORed());
+    Serial.print("] IR[");
+    Serial.print(particleSensor.getFIFOIR());
+    Serial.println("]");
+    particleSensor.nextSample();
+  }
+
+  delay(CHECK_MILLIS);
+}
@@ -0,0 +1,79 @@
+/*
+  Pulse transit time between two sensors
+  SparkFun Electronics
+
+  Put one sensor on a finger and the other on a toe (or an earlobe and a finger). The
+  pulse reaches the further site later, and that delay, the pulse transit time, gets
+  shorter when blood pressure goes up. This example prints the delay on every beat.
+  Watch how it changes rather than its value, it is a trend and not a blood pressure.
+
+  Both sensors have the same I2C address so they need a board with two I2C ports.
+  The first sensor is on Wire and the second on Wire1.
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = SDA (first sensor), SDA1 (second sensor)
+  -SCL = SCL (first sensor), SCL1 (second sensor)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "pulseTransitTime.h"
+
+MAX30105 fingerSensor;
+MAX30105 toeSensor;
+
+//400 samples per second averaged by 4 gives 100 samples per second, 10ms apart
+#define SAMPLE_PERIOD_US 10000
+PulseTransitTime<100> transitTime; //Delays up to 160ms either way
+
+//check() hands each block of new samples over as it reads them. A long drain comes in several blocks,
+//and each one carries its place in the drain and the time check() found it, so every sample gets its own time.
+void fingerSamples(const SampleSpan &samples, void *context)
+{
+  transitTime.add(0, samples, samples.checkMicros, SAMPLE_PERIOD_US);
+}
+
+void toeSamples(const SampleSpan &samples, void *context)
+{
+  transitTime.add(1, samples, samples.checkMicros, SAMPLE_PERIOD_US);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!fingerSensor.begin(Wire, I2C_SPEED_FAST) || !toeSensor.begin(Wire1, I2C_SPEED_FAST))
+  {
+    Serial.println("Both MAX30105s weren't found. Please check wiring/power. ");
+    while (1);
+  }
+
+  fingerSensor.setup(0x1F, 4, 2, 400, 411, 4096);
+  toeSensor.setup(0x1F, 4, 2, 400, 411, 4096);
+  fingerSensor.onSamples(fingerSamples);
+  toeSensor.onSamples(toeSamples);
+}
+
+void loop()
+{
+  //Read both often so the time of each read is close to when the samples were taken
+  fingerSensor.check(); //Callbacks are made from in here
+  toeSensor.check();
+
+  if (transitTime.available())
+  {
+    Serial.print("Transit time ms=");
+    Serial.print(transitTime.getDelayMicros(1) / 1000.0, 1);
+    Serial.print(", Confidence=");
+    Serial.print(transitTime.getConfidence(1));
+    Serial.println("%");
+  }
+}
@@ -0,0 +1,80 @@
+/*
+  Filtering the pulse with a compile-time filter chain
+  SparkFun Electronics
+
+  FilterChain strings filter stages together as template arguments. This example
+  removes DC from the IR signal, band-passes it to 0.5 to 4Hz (30 to 240bpm) and
+  smooths it with a 4 point moving average, then plots the result. The fixed point
+  and float versions of the same chain are drawn on top of each other.
+
+  The band-pass coefficients are for 25 samples a second, so the sensor samples at
+  100sps and averages 4. Use BIQUAD_PPG_50HZ or BIQUAD_PPG_100HZ at other rates.
+
+  Instructions:
+  1) Load code onto Redboard
+  2) Attach sensor to your finger with a rubber band
+  3) Open Tools->'Serial Plotter'
+  4) Make sure the drop down is set to 115200 baud
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "filterChain.h"
+
+MAX30105 particleSensor;
+
+PPGFilter25<int32_t> fixedFilter; //DC blocker, band-pass and moving average in fixed point
+PPGFilter25<float> floatFilter; //The same chain in float
+
+//A chain can also be spelled out stage by stage, here a DC blocker and a 1-2-1 FIR smoother
+FilterChain<DCBlocker<int32_t, 4>, FIRFilter<int32_t, 2, 1, 2, 1>> simpleFilter;
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  byte ledBrightness = 0x1F; //Options: 0=Off to 255=50mA
+  byte sampleAverage = 4; //Options: 1, 2, 4, 8, 16, 32
+  byte ledMode = 2; //Options: 1 = Red only, 2 = Red + IR, 3 = Red + IR + Green
+  int sampleRate = 100; //Options: 50, 100, 200, 400, 800, 1000, 1600, 3200
+  int pulseWidth = 411; //Options: 69, 118, 215, 411
+  int adcRange = 4096; //Options: 2048, 4096, 8192, 16384
+
+  particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange); //25 records a second
+}
+
+void loop()
+{
+  particleSensor.check(); //Check the sensor, read up to 3 samples
+
+  while (particleSensor.available())
+  {
+    int32_t ir = particleSensor.getFIFOIR();
+
+    Serial.print(fixedFilter.process(ir));
+    Serial.print(",");
+    Serial.print(floatFilter.process((float)ir));
+    Serial.print(",");
+    Serial.println(simpleFilter.process(ir));
+
+    particleSensor.nextSample();
+  }
+}
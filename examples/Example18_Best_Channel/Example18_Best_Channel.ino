@@ -0,0 +1,96 @@
+/*
+  Heart rate from the best of red, IR and green
+  SparkFun Electronics
+
+  Example5 looks for beats in the IR signal only. On a wrist, or with a loose fit,
+  green often has a much cleaner pulse. ChannelArbiter watches all three LEDs,
+  scores each by its pulse size relative to its DC level, and runs the beat
+  detector on whichever is best. It prints the BPM on every beat along with the
+  channel that found it, and says when it moves to a different channel.
+
+  Instructions:
+  1) Load code onto Redboard
+  2) Attach sensor to your finger or wrist with a rubber band
+  3) Open Tools->'Serial Monitor'
+  4) Make sure the drop down is set to 115200 baud
+
+  Hardware Connections (Breakoutboard to Arduino):
+  -5V = 5V (3.3V is allowed)
+  -GND = GND
+  -SDA = A4 (or SDA)
+  -SCL = A5 (or SCL)
+  -INT = Not connected
+
+  The MAX30105 Breakout can handle 5V or 3.3V I2C logic. We recommend powering the board with 5V
+  but it will also run at 3.3V.
+*/
+
+#include <Wire.h>
+#include "MAX30105.h"
+
+#include "channelArbiter.h"
+
+MAX30105 particleSensor;
+
+ChannelArbiter arbiter(25); //Samples a second reaching update(), sampleRate / sampleAverage
+
+const char *channelNames[] = {"red", "IR", "green"};
+
+long lastBeat = 0; //Time at which the last beat occurred
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Initializing...");
+
+  if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) //Use default I2C port, 400kHz speed
+  {
+    Serial.println("MAX30105 was not found. Please check wiring/power. ");
+    while (1);
+  }
+
+  byte ledBrightness = 0x1F; //Options: 0=Off to 255=50mA
+  byte sampleAverage = 4; //Options: 1, 2, 4, 8, 16, 32
+  byte ledMode = 3; //Options: 1 = Red only, 2 = Red + IR, 3 = Red + IR + Green
+  int sampleRate = 100; //Options: 50, 100, 200, 400, 800, 1000, 1600, 3200
+  int pulseWidth = 411; //Options: 69, 118, 215, 411
+  int adcRange = 4096; //Options: 2048, 4096, 8192, 16384
+
+  particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange); //25 records a second
+}
+
+void loop()
+{
+  particleSensor.check(); //Check the sensor, read up to 3 samples
+
+  while (particleSensor.available())
+  {
+    bool beat = arbiter.update(particleSensor.getFIFORed(), particleSensor.getFIFOIR(), particleSensor.getFIFOGreen());
+    particleSensor.nextSample();
+
+    if (arbiter.channelChanged())
+    {
+      Serial.print("Now using ");
+      Serial.println(channelNames[arbiter.getChannel()]);
+      lastBeat = 0; //The detector restarted, don't time a beat across the switch
+    }
+
+    if (beat == false) continue;
+
+    long now = millis();
+    if (lastBeat != 0)
+    {
+      Serial.print("BPM=");
+      Serial.print(60 / ((now - lastBeat) / 1000.0), 1);
+      Serial.print(" from ");
+      Serial.print(channelNames[arbiter.getChannel()]);
+      Serial.print(", scores red ");
+      Serial.print(arbiter.getScore(ARBITER_RED));
+      Serial.print(" IR ");
+      Serial.print(arbiter.getScore(ARBITER_IR));
+      Serial.print(" green ");
+      Serial.println(arbiter.getScore(ARBITER_GREEN));
+    }
+    lastBeat = now;
+  }
+}
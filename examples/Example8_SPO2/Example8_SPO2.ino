@@ -102,6 +102,7 @@ void loop()
   }
 
   //calculate heart rate and SpO2 after first 100 samples (first 4 seconds of samples)
+  //For other sample rates or window lengths use the template, ie maxim_heart_rate_and_oxygen_saturation<50, 200>(...)
   maxim_heart_rate_and_oxygen_saturation(irBuffer, bufferLength, redBuffer, &spo2, &validSPO2, &heartRate, &validHeartRate);
 
   //Continuously taking samples from MAX30102.  Heart rate and SpO2 are calculated every 1 second
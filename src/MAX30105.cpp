@@ -10,6 +10,7 @@
  *****************************************************/
 
 #include "MAX30105.h"
+#include "spscRing.h"
 
 // Status Registers
 static const uint8_t MAX30105_INTSTAT1 =		0x00;
@@ -33,6 +34,9 @@ static const uint8_t MAX30105_LED3_PULSEAMP = 	0x0E;
 static const uint8_t MAX30105_LED_PROX_AMP = 	0x10;
 static const uint8_t MAX30105_MULTILEDCONFIG1 = 0x11;
 static const uint8_t MAX30105_MULTILEDCONFIG2 = 0x12;
+static const uint8_t MAX30105_RESERVED1 = 		0x0B;
+static const uint8_t MAX30105_RESERVED2 = 		0x0F;
+static const uint8_t MAX30105_CONFIG_LENGTH = 	MAX30105_MULTILEDCONFIG2 - MAX30105_FIFOCONFIG + 1; //0x08 to 0x12
 
 // Die Temperature Registers
 static const uint8_t MAX30105_DIETEMPINT = 		0x1F;
@@ -135,8 +139,43 @@ static const uint8_t SLOT_GREEN_PILOT = 		0x07;
 
 static const uint8_t MAX_30105_EXPECTEDPARTID = 0x15;
 
+//sense.head and sense.tail are free running and masked into the arrays
+static const uint8_t STORAGE_MASK = STORAGE_SIZE - 1;
+static_assert(STORAGE_SIZE <= 128 && (STORAGE_SIZE & STORAGE_MASK) == 0, "STORAGE_SIZE must be a power of two up to 128");
+
+//FIFO channels, indexes into channelSlot
+static const uint8_t CHANNEL_RED = 0;
+static const uint8_t CHANNEL_IR = 1;
+static const uint8_t CHANNEL_GREEN = 2;
+static const uint8_t CHANNEL_NONE = 0xFF;
+
 MAX30105::MAX30105() {
   // Constructor
+  activeLEDs = 0;
+  ledModeSetting = 0;
+  for (uint8_t x = 0 ; x < 4 ; x++) slotDevice[x] = SLOT_NONE;
+  channelSlot[CHANNEL_RED] = channelSlot[CHANNEL_IR] = channelSlot[CHANNEL_GREEN] = CHANNEL_NONE;
+  memset(&sense, 0, sizeof(sense));
+  maxReadSize = I2C_BUFFER_LENGTH;
+  samplesCallback = NULL;
+  samplesContext = NULL;
+  drainLeft = 0;
+  drainMicros = 0;
+  fifoOverflow = 0;
+
+  _i2cPort = NULL;
+  _i2cSpeed = I2C_SPEED_STANDARD;
+  i2cStatus = MAX30105_I2C_OK;
+  i2cErrors = 0;
+  i2cRetries = MAX30105_I2C_RETRIES;
+  i2cTimeout = MAX30105_I2C_TIMEOUT_US;
+  autoRecover = true;
+  recoverySDA = recoverySCL = 0xFF;
+  memset(configShadow, 0, sizeof(configShadow));
+  memset(interruptShadow, 0, sizeof(interruptShadow));
+  proxThresholdShadow = 0;
+  shadowValid = false;
+  static_assert(sizeof(configShadow) == MAX30105_CONFIG_LENGTH, "configShadow must hold registers 0x08 to 0x12");
 }
 
 boolean MAX30105::begin(TwoWire &wirePort, uint32_t i2cSpeed, uint8_t i2caddr) {
@@ -145,12 +184,23 @@ boolean MAX30105::begin(TwoWire &wirePort, uint32_t i2cSpeed, uint8_t i2caddr) {
 
   _i2cPort->begin();
   _i2cPort->setClock(i2cSpeed);
+  _i2cSpeed = i2cSpeed;
+  applyI2CTimeout();
 
   _i2caddr = i2caddr;
 
+#if defined(PIN_WIRE_SDA) && defined(PIN_WIRE_SCL)
+  //The default port's pins are known, other ports need setRecoveryPins()
+  if (_i2cPort == &Wire && recoverySDA == 0xFF) setRecoveryPins(PIN_WIRE_SDA, PIN_WIRE_SCL);
+#endif
+
   // Step 1: Initial Communication and Verification
   // Check that a MAX30105 is connected
-  if (readPartID() != MAX_30105_EXPECTEDPARTID) {
+  // A device left part way through a transfer by a reset of the micro can hold the bus, so free it and try again
+  uint8_t partID = 0;
+  if (readRegister8(_i2caddr, MAX30105_PARTID, partID) != MAX30105_I2C_OK && recoverBus() == MAX30105_I2C_OK)
+    readRegister8(_i2caddr, MAX30105_PARTID, partID);
+  if (i2cStatus != MAX30105_I2C_OK || partID != MAX_30105_EXPECTEDPARTID) {
     // Error -- Part ID read from MAX30105 does not match expected part ID.
     // This may mean there is a physical connectivity problem (broken wire, unpowered, etc).
     return false;
@@ -219,8 +269,16 @@ void MAX30105::softReset(void) {
   unsigned long startTime = millis();
   while (millis() - startTime < 100)
   {
-    uint8_t response = readRegister8(_i2caddr, MAX30105_MODECONFIG);
-    if ((response & MAX30105_RESET) == 0) break; //We're done!
+    uint8_t response;
+    if (readRegister8(_i2caddr, MAX30105_MODECONFIG, response) == MAX30105_I2C_OK && (response & MAX30105_RESET) == 0)
+    {
+      //Every register we keep a copy of is back to 0x00
+      memset(configShadow, 0, sizeof(configShadow));
+      memset(interruptShadow, 0, sizeof(interruptShadow));
+      proxThresholdShadow = 0;
+      shadowValid = true;
+      break; //We're done!
+    }
     delay(1); //Let's not over burden the I2C bus
   }
 }
@@ -241,6 +299,9 @@ void MAX30105::setLEDMode(uint8_t mode) {
   // Set which LEDs are used for sampling -- Red only, RED+IR only, or custom.
   // See datasheet, page 19
   bitMask(MAX30105_MODECONFIG, MAX30105_MODE_MASK, mode);
+
+  ledModeSetting = mode;
+  updateSlotMap();
 }
 
 void MAX30105::setADCRange(uint8_t adcRange) {
@@ -306,14 +367,48 @@ void MAX30105::enableSlot(uint8_t slotNumber, uint8_t device) {
       break;
     default:
       //Shouldn't be here!
-      break;
+      return;
   }
+
+  slotDevice[slotNumber - 1] = device;
+  updateSlotMap();
 }
 
 //Clears all slot assignments
 void MAX30105::disableSlots(void) {
   writeRegister8(_i2caddr, MAX30105_MULTILEDCONFIG1, 0);
   writeRegister8(_i2caddr, MAX30105_MULTILEDCONFIG2, 0);
+
+  for (uint8_t x = 0 ; x < 4 ; x++) slotDevice[x] = SLOT_NONE;
+  updateSlotMap();
+}
+
+//Work out the FIFO record layout from the mode and slot assignments (datasheet pg. 22)
+//Red only and SpO2 modes always store red then IR. Multi-LED mode stores the slots in
+//order, stopping at the first empty one. A pilot slot stores the LED it pulses.
+void MAX30105::updateSlotMap(void) {
+  channelSlot[CHANNEL_RED] = channelSlot[CHANNEL_IR] = channelSlot[CHANNEL_GREEN] = CHANNEL_NONE;
+
+  if (ledModeSetting == MAX30105_MODE_REDONLY || ledModeSetting == MAX30105_MODE_REDIRONLY)
+  {
+    channelSlot[CHANNEL_RED] = 0;
+    activeLEDs = 1;
+    if (ledModeSetting == MAX30105_MODE_REDIRONLY)
+    {
+      channelSlot[CHANNEL_IR] = 1;
+      activeLEDs = 2;
+    }
+    return;
+  }
+
+  activeLEDs = 0;
+  for (uint8_t x = 0 ; x < 4 ; x++)
+  {
+    uint8_t led = slotDevice[x] & 0x03; //1 red, 2 IR, 3 green, same for the pilot devices
+    if (led == 0) break; //SLOT_NONE or SLOT_NONE_PILOT ends the record
+    if (channelSlot[led - 1] == CHANNEL_NONE) channelSlot[led - 1] = x;
+    activeLEDs++;
+  }
 }
 
 //
@@ -328,9 +423,9 @@ void MAX30105::setFIFOAverage(uint8_t numberOfSamples) {
 //Resets all points to start in a known state
 //Page 15 recommends clearing FIFO before beginning a read
 void MAX30105::clearFIFO(void) {
-  writeRegister8(_i2caddr, MAX30105_FIFOWRITEPTR, 0);
-  writeRegister8(_i2caddr, MAX30105_FIFOOVERFLOW, 0);
-  writeRegister8(_i2caddr, MAX30105_FIFOREADPTR, 0);
+  //Write pointer, overflow counter and read pointer are consecutive so clear them in one write
+  const uint8_t zeros[3] = {0, 0, 0};
+  writeRegisters(MAX30105_FIFOWRITEPTR, zeros, 3);
 }
 
 //Enable roll over if FIFO over flows
@@ -350,6 +445,64 @@ void MAX30105::setFIFOAlmostFull(uint8_t numberOfSamples) {
   bitMask(MAX30105_FIFOCONFIG, MAX30105_A_FULL_MASK, numberOfSamples);
 }
 
+//Set the largest number of bytes check() asks for in one requestFrom()
+//Use this when the Wire library's buffer is larger than I2C_BUFFER_LENGTH
+void MAX30105::setMaxReadSize(uint8_t bytes) {
+  maxReadSize = bytes > 0 ? bytes : 1;
+}
+
+//Request more than any Wire buffer is likely to hold and see how much we get
+//Reads from the proximity threshold register up, which has nothing that clears on read
+//Relies on requestFrom() returning what it buffered. If your core doesn't, use setMaxReadSize().
+//Returns the new read size, or 0 if the part didn't answer. maxReadSize is then left as it was and
+//getI2CStatus() says why.
+uint8_t MAX30105::discoverMaxReadSize(void) {
+  const uint8_t probeBytes = 192; //0x30 + 192 stays below 0xFF so the register address doesn't wrap
+
+  uint8_t attempts = 0;
+  while ((i2cStatus = writeAttempt(_i2caddr, MAX30105_PROXINTTHRESH, NULL, 0, false)) != MAX30105_I2C_OK)
+  {
+    countI2CError();
+    if (attempts++ >= i2cRetries) return (0);
+  }
+
+  uint8_t received = _i2cPort->requestFrom((uint8_t)_i2caddr, probeBytes);
+  while (_i2cPort->available()) _i2cPort->read(); //Throw the register contents away
+
+  if (received == 0)
+  {
+    //Nothing came back, which says nothing about the buffer size
+    i2cStatus = MAX30105_I2C_NACK;
+#if defined(WIRE_HAS_TIMEOUT)
+    if (_i2cPort->getWireTimeoutFlag())
+    {
+      _i2cPort->clearWireTimeoutFlag();
+      i2cStatus = MAX30105_I2C_TIMEOUT;
+    }
+#endif
+    countI2CError();
+    return (0);
+  }
+
+  maxReadSize = received;
+  return (maxReadSize);
+}
+
+//Number of requestFrom() calls check() will make to read this many samples
+uint8_t MAX30105::transactionsFor(uint16_t samples) {
+  uint16_t bytes = samples * activeLEDs * 3;
+  uint8_t block = readBlockBytes();
+  return ((bytes + block - 1) / block);
+}
+
+//Bytes check() asks for in one requestFrom(): maxReadSize trimmed to whole records, at least one record
+uint8_t MAX30105::readBlockBytes(void) {
+  uint8_t recordBytes = activeLEDs * 3;
+  if (recordBytes == 0) return (maxReadSize); //Not set up yet
+  uint8_t block = maxReadSize - (maxReadSize % recordBytes);
+  return (block > 0 ? block : recordBytes);
+}
+
 //Read the FIFO Write Pointer
 uint8_t MAX30105::getWritePointer(void) {
   return (readRegister8(_i2caddr, MAX30105_FIFOWRITEPTR));
@@ -360,6 +513,25 @@ uint8_t MAX30105::getReadPointer(void) {
   return (readRegister8(_i2caddr, MAX30105_FIFOREADPTR));
 }
 
+//Records the part holds that check() hasn't read yet
+//Write pointer, overflow counter and read pointer in one read. Equal pointers are a full FIFO if it has overflowed.
+//If the read fails the FIFO is taken to be full, so callers timing a setting change don't count old samples as new.
+uint8_t MAX30105::getFIFOCount(void) {
+  byte pointers[3];
+  if (readRegisters(MAX30105_FIFOWRITEPTR, pointers, 3) == false) return (32);
+
+  byte count = ((pointers[0] & 0x1F) - (pointers[2] & 0x1F)) & 0x1F;
+  if (count == 0 && (pointers[1] & 0x1F) > 0) count = 32;
+  return (count);
+}
+
+//Samples lost to FIFO overflow seen by check() since the last call
+uint16_t MAX30105::getOverflowCount(void) {
+  uint16_t count = fifoOverflow;
+  fifoOverflow = 0;
+  return (count);
+}
+
 
 // Die Temperature
 // Returns temp in C
@@ -409,6 +581,16 @@ void MAX30105::setPROXINTTHRESH(uint8_t val) {
   writeRegister8(_i2caddr, MAX30105_PROXINTTHRESH, val);
 }
 
+// With PROX_INT enabled the part runs the pilot LED only until the IR count crosses
+// PROX_INT_THRESH, then changes to the programmed mode by itself.
+// Writing the mode register again starts proximity sensing over (datasheet pg. 12)
+// If the mode can't be read it is left alone, writing back 0 would stop sampling
+void MAX30105::reenterProximityMode(void) {
+  uint8_t mode;
+  if (readRegister8(_i2caddr, MAX30105_MODECONFIG, mode) != MAX30105_I2C_OK) return;
+  writeRegister8(_i2caddr, MAX30105_MODECONFIG, mode & ~MAX30105_RESET);
+}
+
 
 //
 // Device ID and Revision
@@ -436,55 +618,127 @@ uint8_t MAX30105::getRevisionID() {
 void MAX30105::setup(byte powerLevel, byte sampleAverage, byte ledMode, int sampleRate, int pulseWidth, int adcRange) {
   softReset(); //Reset all configuration, threshold, and data registers to POR values
 
+  //Every configuration register is 0x00 after reset so the whole image can be written in one go
+  uint8_t image[MAX30105_CONFIG_LENGTH];
+  configImage(image, powerLevel, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
+  writeRegisters(MAX30105_FIFOCONFIG, image, MAX30105_CONFIG_LENGTH);
+  loadSlotMap(image);
+
+  clearFIFO(); //Reset the FIFO before we begin checking the sensor
+}
+
+//Bring the sensor back after the micro has slept, without the reset and register by register setup
+//If the part already holds this configuration only the FIFO is cleared, otherwise the configuration
+//is written in one burst. The arguments are the same as setup().
+//Returns RESUME_WARM or RESUME_WRITTEN, or RESUME_FAILED if the part didn't answer with its ID.
+uint8_t MAX30105::resume(byte powerLevel, byte sampleAverage, byte ledMode, int sampleRate, int pulseWidth, int adcRange) {
+  if (readPartID() != MAX_30105_EXPECTEDPARTID) return (RESUME_FAILED);
+
+  uint8_t image[MAX30105_CONFIG_LENGTH];
+  configImage(image, powerLevel, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
+
+  uint8_t result = restoreConfig(image);
+  if (result == RESUME_FAILED) return (RESUME_FAILED);
+
+  //Samples from before the sleep are stale
+  sense.head = 0;
+  sense.tail = 0;
+
+  return (result);
+}
+
+//Write image to registers 0x08 to 0x12 unless the part already holds it, then clear the FIFO
+//A part that only differs in the shutdown bit, one put to sleep with shutDown(), is woken (or put back to
+//sleep) with a single write and still counts as warm. The reserved registers aren't compared, both images
+//and setup() leave them 0.
+//Returns RESUME_WARM, RESUME_WRITTEN or RESUME_FAILED
+uint8_t MAX30105::restoreConfig(const uint8_t *image) {
+  uint8_t current[MAX30105_CONFIG_LENGTH];
+  if (readRegisters(MAX30105_FIFOCONFIG, current, MAX30105_CONFIG_LENGTH) == false) return (RESUME_FAILED);
+
+  const uint8_t mode = MAX30105_MODECONFIG - MAX30105_FIFOCONFIG;
+  bool matches = true;
+  for (uint8_t x = 0 ; x < MAX30105_CONFIG_LENGTH ; x++)
+  {
+    if (x == MAX30105_RESERVED1 - MAX30105_FIFOCONFIG || x == MAX30105_RESERVED2 - MAX30105_FIFOCONFIG) continue;
+    uint8_t ignore = (x == mode ? MAX30105_SHUTDOWN : 0);
+    if ((image[x] | ignore) != (current[x] | ignore)) matches = false;
+  }
+
+  uint8_t result = RESUME_WARM;
+  if (matches == false)
+  {
+    if (writeRegisters(MAX30105_FIFOCONFIG, image, MAX30105_CONFIG_LENGTH) != MAX30105_I2C_OK) return (RESUME_FAILED);
+    result = RESUME_WRITTEN;
+  }
+  else if (image[mode] != current[mode])
+  {
+    if (writeRegister8(_i2caddr, MAX30105_MODECONFIG, image[mode]) != MAX30105_I2C_OK) return (RESUME_FAILED);
+  }
+
+  loadSlotMap(image); //Our copy may have been lost if the micro was reset
+  memcpy(configShadow, image, MAX30105_CONFIG_LENGTH);
+  shadowValid = true;
+
+  clearFIFO();
+  return (result);
+}
+
+//Register values 0x08 to 0x12 that setup() gives from a reset part
+void MAX30105::configImage(uint8_t *image, byte powerLevel, byte sampleAverage, byte ledMode, int sampleRate, int pulseWidth, int adcRange) {
+  memset(image, 0, MAX30105_CONFIG_LENGTH);
+  uint8_t &fifoConfig = image[MAX30105_FIFOCONFIG - MAX30105_FIFOCONFIG];
+  uint8_t &modeConfig = image[MAX30105_MODECONFIG - MAX30105_FIFOCONFIG];
+  uint8_t &particleConfig = image[MAX30105_PARTICLECONFIG - MAX30105_FIFOCONFIG];
+
   //FIFO Configuration
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
   //The chip will average multiple samples of same type together if you wish
-  if (sampleAverage == 1) setFIFOAverage(MAX30105_SAMPLEAVG_1); //No averaging per FIFO record
-  else if (sampleAverage == 2) setFIFOAverage(MAX30105_SAMPLEAVG_2);
-  else if (sampleAverage == 4) setFIFOAverage(MAX30105_SAMPLEAVG_4);
-  else if (sampleAverage == 8) setFIFOAverage(MAX30105_SAMPLEAVG_8);
-  else if (sampleAverage == 16) setFIFOAverage(MAX30105_SAMPLEAVG_16);
-  else if (sampleAverage == 32) setFIFOAverage(MAX30105_SAMPLEAVG_32);
-  else setFIFOAverage(MAX30105_SAMPLEAVG_4);
-
-  //setFIFOAlmostFull(2); //Set to 30 samples to trigger an 'Almost Full' interrupt
-  enableFIFORollover(); //Allow FIFO to wrap/roll over
+  if (sampleAverage == 1) fifoConfig |= MAX30105_SAMPLEAVG_1; //No averaging per FIFO record
+  else if (sampleAverage == 2) fifoConfig |= MAX30105_SAMPLEAVG_2;
+  else if (sampleAverage == 4) fifoConfig |= MAX30105_SAMPLEAVG_4;
+  else if (sampleAverage == 8) fifoConfig |= MAX30105_SAMPLEAVG_8;
+  else if (sampleAverage == 16) fifoConfig |= MAX30105_SAMPLEAVG_16;
+  else if (sampleAverage == 32) fifoConfig |= MAX30105_SAMPLEAVG_32;
+  else fifoConfig |= MAX30105_SAMPLEAVG_4;
+
+  //Almost full left at 0, 32 samples
+  fifoConfig |= MAX30105_ROLLOVER_ENABLE; //Allow FIFO to wrap/roll over
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
   //Mode Configuration
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-  if (ledMode == 3) setLEDMode(MAX30105_MODE_MULTILED); //Watch all three LED channels
-  else if (ledMode == 2) setLEDMode(MAX30105_MODE_REDIRONLY); //Red and IR
-  else setLEDMode(MAX30105_MODE_REDONLY); //Red only
-  activeLEDs = ledMode; //Used to control how many bytes to read from FIFO buffer
+  if (ledMode == 3) modeConfig |= MAX30105_MODE_MULTILED; //Watch all three LED channels
+  else if (ledMode == 2) modeConfig |= MAX30105_MODE_REDIRONLY; //Red and IR
+  else modeConfig |= MAX30105_MODE_REDONLY; //Red only
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
   //Particle Sensing Configuration
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-  if(adcRange < 4096) setADCRange(MAX30105_ADCRANGE_2048); //7.81pA per LSB
-  else if(adcRange < 8192) setADCRange(MAX30105_ADCRANGE_4096); //15.63pA per LSB
-  else if(adcRange < 16384) setADCRange(MAX30105_ADCRANGE_8192); //31.25pA per LSB
-  else if(adcRange == 16384) setADCRange(MAX30105_ADCRANGE_16384); //62.5pA per LSB
-  else setADCRange(MAX30105_ADCRANGE_2048);
-
-  if (sampleRate < 100) setSampleRate(MAX30105_SAMPLERATE_50); //Take 50 samples per second
-  else if (sampleRate < 200) setSampleRate(MAX30105_SAMPLERATE_100);
-  else if (sampleRate < 400) setSampleRate(MAX30105_SAMPLERATE_200);
-  else if (sampleRate < 800) setSampleRate(MAX30105_SAMPLERATE_400);
-  else if (sampleRate < 1000) setSampleRate(MAX30105_SAMPLERATE_800);
-  else if (sampleRate < 1600) setSampleRate(MAX30105_SAMPLERATE_1000);
-  else if (sampleRate < 3200) setSampleRate(MAX30105_SAMPLERATE_1600);
-  else if (sampleRate == 3200) setSampleRate(MAX30105_SAMPLERATE_3200);
-  else setSampleRate(MAX30105_SAMPLERATE_50);
+  if(adcRange < 4096) particleConfig |= MAX30105_ADCRANGE_2048; //7.81pA per LSB
+  else if(adcRange < 8192) particleConfig |= MAX30105_ADCRANGE_4096; //15.63pA per LSB
+  else if(adcRange < 16384) particleConfig |= MAX30105_ADCRANGE_8192; //31.25pA per LSB
+  else if(adcRange == 16384) particleConfig |= MAX30105_ADCRANGE_16384; //62.5pA per LSB
+  else particleConfig |= MAX30105_ADCRANGE_2048;
+
+  if (sampleRate < 100) particleConfig |= MAX30105_SAMPLERATE_50; //Take 50 samples per second
+  else if (sampleRate < 200) particleConfig |= MAX30105_SAMPLERATE_100;
+  else if (sampleRate < 400) particleConfig |= MAX30105_SAMPLERATE_200;
+  else if (sampleRate < 800) particleConfig |= MAX30105_SAMPLERATE_400;
+  else if (sampleRate < 1000) particleConfig |= MAX30105_SAMPLERATE_800;
+  else if (sampleRate < 1600) particleConfig |= MAX30105_SAMPLERATE_1000;
+  else if (sampleRate < 3200) particleConfig |= MAX30105_SAMPLERATE_1600;
+  else if (sampleRate == 3200) particleConfig |= MAX30105_SAMPLERATE_3200;
+  else particleConfig |= MAX30105_SAMPLERATE_50;
 
   //The longer the pulse width the longer range of detection you'll have
   //At 69us and 0.4mA it's about 2 inches
   //At 411us and 0.4mA it's about 6 inches
-  if (pulseWidth < 118) setPulseWidth(MAX30105_PULSEWIDTH_69); //Page 26, Gets us 15 bit resolution
-  else if (pulseWidth < 215) setPulseWidth(MAX30105_PULSEWIDTH_118); //16 bit resolution
-  else if (pulseWidth < 411) setPulseWidth(MAX30105_PULSEWIDTH_215); //17 bit resolution
-  else if (pulseWidth == 411) setPulseWidth(MAX30105_PULSEWIDTH_411); //18 bit resolution
-  else setPulseWidth(MAX30105_PULSEWIDTH_69);
+  if (pulseWidth < 118) particleConfig |= MAX30105_PULSEWIDTH_69; //Page 26, Gets us 15 bit resolution
+  else if (pulseWidth < 215) particleConfig |= MAX30105_PULSEWIDTH_118; //16 bit resolution
+  else if (pulseWidth < 411) particleConfig |= MAX30105_PULSEWIDTH_215; //17 bit resolution
+  else if (pulseWidth == 411) particleConfig |= MAX30105_PULSEWIDTH_411; //18 bit resolution
+  else particleConfig |= MAX30105_PULSEWIDTH_69;
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
   //LED Pulse Amplitude Configuration
@@ -495,23 +749,32 @@ void MAX30105::setup(byte powerLevel, byte sampleAverage, byte ledMode, int samp
   //powerLevel = 0x7F, 25.4mA - Presence detection of ~8 inch
   //powerLevel = 0xFF, 50.0mA - Presence detection of ~12 inch
 
-  setPulseAmplitudeRed(powerLevel);
-  setPulseAmplitudeIR(powerLevel);
-  setPulseAmplitudeGreen(powerLevel);
-  setPulseAmplitudeProximity(powerLevel);
+  image[MAX30105_LED1_PULSEAMP - MAX30105_FIFOCONFIG] = powerLevel;
+  image[MAX30105_LED2_PULSEAMP - MAX30105_FIFOCONFIG] = powerLevel;
+  image[MAX30105_LED3_PULSEAMP - MAX30105_FIFOCONFIG] = powerLevel;
+  image[MAX30105_LED_PROX_AMP - MAX30105_FIFOCONFIG] = powerLevel;
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
   //Multi-LED Mode Configuration, Enable the reading of the three LEDs
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-  enableSlot(1, SLOT_RED_LED);
-  if (ledMode > 1) enableSlot(2, SLOT_IR_LED);
-  if (ledMode > 2) enableSlot(3, SLOT_GREEN_LED);
-  //enableSlot(1, SLOT_RED_PILOT);
-  //enableSlot(2, SLOT_IR_PILOT);
-  //enableSlot(3, SLOT_GREEN_PILOT);
+  uint8_t slots = SLOT_RED_LED; //Slot 1 in the low bits, slot 2 in the high
+  if (ledMode > 1) slots |= SLOT_IR_LED << 4;
+  image[MAX30105_MULTILEDCONFIG1 - MAX30105_FIFOCONFIG] = slots;
+  if (ledMode > 2) image[MAX30105_MULTILEDCONFIG2 - MAX30105_FIFOCONFIG] = SLOT_GREEN_LED;
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+}
 
-  clearFIFO(); //Reset the FIFO before we begin checking the sensor
+//Take the LED mode and slot schedule from a configuration image, as setLEDMode() and enableSlot() would
+void MAX30105::loadSlotMap(const uint8_t *image) {
+  uint8_t slots12 = image[MAX30105_MULTILEDCONFIG1 - MAX30105_FIFOCONFIG];
+  uint8_t slots34 = image[MAX30105_MULTILEDCONFIG2 - MAX30105_FIFOCONFIG];
+
+  ledModeSetting = image[MAX30105_MODECONFIG - MAX30105_FIFOCONFIG] & ~MAX30105_MODE_MASK;
+  slotDevice[0] = slots12 & 0x07;
+  slotDevice[1] = (slots12 >> 4) & 0x07;
+  slotDevice[2] = slots34 & 0x07;
+  slotDevice[3] = (slots34 >> 4) & 0x07;
+  updateSlotMap();
 }
 
 //
@@ -521,18 +784,38 @@ void MAX30105::setup(byte powerLevel, byte sampleAverage, byte ledMode, int samp
 //Tell caller how many samples are available
 uint8_t MAX30105::available(void)
 {
-  int8_t numberOfSamples = sense.head - sense.tail;
-  if (numberOfSamples < 0) numberOfSamples += STORAGE_SIZE;
+  //check() never writes over samples we haven't read, so this is at most STORAGE_SIZE - 1
+  return ((byte)(spsc_load_acquire(&sense.head) - sense.tail));
+}
 
-  return (numberOfSamples);
+//Records check() can store before it reaches the one getFIFO*() is reading
+uint8_t MAX30105::bufferSpace(void)
+{
+  return (STORAGE_SIZE - 1 - (byte)(sense.head - spsc_load_acquire(&sense.tail)));
+}
+
+//getRed(), getIR() and getGreen() want the newest reading rather than the next one in the buffer.
+//Drop what is buffered, wait for new data, then keep reading while check() fills the buffer, so
+//nothing newer is left in the part's FIFO. Called from the reading side, like nextSample().
+bool MAX30105::checkNewest(uint8_t maxTimeToCheck)
+{
+  spsc_store_release(&sense.tail, spsc_load_acquire(&sense.head));
+  if (safeCheck(maxTimeToCheck) == false) return (false);
+
+  for (uint8_t x = 0 ; x < 32 / (STORAGE_SIZE - 1) && bufferSpace() == 0 ; x++)
+  {
+    spsc_store_release(&sense.tail, spsc_load_acquire(&sense.head));
+    if (check() == 0) break;
+  }
+  return (true);
 }
 
 //Report the most recent red value
 uint32_t MAX30105::getRed(void)
 {
   //Check the sensor for new data for 250ms
-  if(safeCheck(250))
-    return (sense.red[sense.head]);
+  if(checkNewest(250))
+    return (slotSample(CHANNEL_RED, spsc_load_acquire(&sense.head) & STORAGE_MASK));
   else
     return(0); //Sensor failed to find new data
 }
@@ -541,8 +824,8 @@ uint32_t MAX30105::getRed(void)
 uint32_t MAX30105::getIR(void)
 {
   //Check the sensor for new data for 250ms
-  if(safeCheck(250))
-    return (sense.IR[sense.head]);
+  if(checkNewest(250))
+    return (slotSample(CHANNEL_IR, spsc_load_acquire(&sense.head) & STORAGE_MASK));
   else
     return(0); //Sensor failed to find new data
 }
@@ -551,8 +834,8 @@ uint32_t MAX30105::getIR(void)
 uint32_t MAX30105::getGreen(void)
 {
   //Check the sensor for new data for 250ms
-  if(safeCheck(250))
-    return (sense.green[sense.head]);
+  if(checkNewest(250))
+    return (slotSample(CHANNEL_GREEN, spsc_load_acquire(&sense.head) & STORAGE_MASK));
   else
     return(0); //Sensor failed to find new data
 }
@@ -560,19 +843,34 @@ uint32_t MAX30105::getGreen(void)
 //Report the next Red value in the FIFO
 uint32_t MAX30105::getFIFORed(void)
 {
-  return (sense.red[sense.tail]);
+  return (slotSample(CHANNEL_RED, sense.tail & STORAGE_MASK));
 }
 
 //Report the next IR value in the FIFO
 uint32_t MAX30105::getFIFOIR(void)
 {
-  return (sense.IR[sense.tail]);
+  return (slotSample(CHANNEL_IR, sense.tail & STORAGE_MASK));
 }
 
 //Report the next Green value in the FIFO
 uint32_t MAX30105::getFIFOGreen(void)
 {
-  return (sense.green[sense.tail]);
+  return (slotSample(CHANNEL_GREEN, sense.tail & STORAGE_MASK));
+}
+
+//Report the next value of any slot in the FIFO, slotNumber is 1 to 4
+uint32_t MAX30105::getFIFOSlot(uint8_t slotNumber)
+{
+  if (slotNumber < 1 || slotNumber > activeLEDs) return (0);
+  return (sense.slot[slotNumber - 1][sense.tail & STORAGE_MASK]);
+}
+
+//Reading of an LED channel, 0 if no slot holds it
+uint32_t MAX30105::slotSample(uint8_t channel, byte index)
+{
+  uint8_t slot = channelSlot[channel];
+  if (slot == CHANNEL_NONE) return (0);
+  return (sense.slot[slot][index]);
 }
 
 //Advance the tail
@@ -580,115 +878,171 @@ void MAX30105::nextSample(void)
 {
   if(available()) //Only advance the tail if new data is available
   {
-    sense.tail++;
-    sense.tail %= STORAGE_SIZE; //Wrap condition
+    spsc_store_release(&sense.tail, (byte)(sense.tail + 1)); //Hand the slot back to check()
   }
 }
 
+//Read records of SLOTS slots from the I2C buffer into the sense array
+//Each reading is 3 bytes, MSB first, of which the low 18 bits are data
+template <uint8_t SLOTS>
+void MAX30105::readRecords(int records)
+{
+  byte head = sense.head;
+
+  while (records > 0)
+  {
+    //With a callback, deliver in blocks the buffer can hold
+    int batch = records;
+    if (samplesCallback != NULL && batch > STORAGE_SIZE - 1) batch = STORAGE_SIZE - 1;
+    records -= batch;
+
+    byte first = head + 1;
+    while (batch-- > 0)
+    {
+      head++; //Advance the head of the storage struct
+
+      for (uint8_t x = 0 ; x < SLOTS ; x++)
+      {
+        uint32_t tempLong = (uint32_t)_i2cPort->read() << 16;
+        tempLong |= (uint32_t)_i2cPort->read() << 8;
+        tempLong |= _i2cPort->read();
+
+        sense.slot[x][head & STORAGE_MASK] = tempLong & 0x3FFFF; //Zero out all but 18 bits
+      }
+    }
+
+    spsc_store_release(&sense.head, head); //Publish the batch after the samples are written
+    if (samplesCallback != NULL) deliverSamples(first, head - first + 1);
+  }
+}
+
+void MAX30105::onSamples(SamplesCallback callback, void *context)
+{
+  samplesContext = context;
+  samplesCallback = callback;
+}
+
+void MAX30105::deliverSamples(byte first, uint8_t count)
+{
+  SampleSpan span;
+  span.redRow = channelSlot[CHANNEL_RED] == CHANNEL_NONE ? NULL : sense.slot[channelSlot[CHANNEL_RED]];
+  span.irRow = channelSlot[CHANNEL_IR] == CHANNEL_NONE ? NULL : sense.slot[channelSlot[CHANNEL_IR]];
+  span.greenRow = channelSlot[CHANNEL_GREEN] == CHANNEL_NONE ? NULL : sense.slot[channelSlot[CHANNEL_GREEN]];
+  span.first = first;
+  span.mask = STORAGE_MASK;
+  span.count = count;
+  drainLeft = (drainLeft > count ? drainLeft - count : 0);
+  span.later = drainLeft;
+  span.checkMicros = drainMicros;
+
+  samplesCallback(span, samplesContext);
+
+  //The callback is the reader, it has had the block so give the space back
+  spsc_store_release(&sense.tail, (byte)(first + count - 1));
+}
+
 //Polls the sensor for new data
 //Call regularly
-//If new data is available, it updates the head and tail in the main struct
+//If new data is available, it updates the head of the main struct. Records that don't fit in the
+//buffer are left in the part's FIFO until nextSample() makes room.
 //Returns number of new samples obtained
+//On an I2C error it returns what was read before the error and, unless setAutoRecover(false),
+//calls recover() so the next check() starts from a working bus and a configured part
+//Time it can block on a failing bus, with T the I2C timeout (25ms by default) and R the retries (2):
+//the failed access takes up to (R + 1) * 2T, register address and data, and recover() up to 8T more.
+//That is 350ms with the defaults on top of the transactions that worked, 10T with setI2CRetries(0).
+//On cores without WIRE_HAS_TIMEOUT a transaction is only as bounded as the Wire library makes it.
 uint16_t MAX30105::check(void)
 {
   //Read register FIDO_DATA in (3-byte * number of active LED) chunks
   //Until FIFO_RD_PTR = FIFO_WR_PTR
 
-  byte readPointer = getReadPointer();
-  byte writePointer = getWritePointer();
+  //Write pointer, overflow counter and read pointer in one read
+  byte pointers[3];
+  if (readRegisters(MAX30105_FIFOWRITEPTR, pointers, 3) == false)
+  {
+    if (autoRecover) recover();
+    return (0);
+  }
+  byte writePointer = pointers[0] & 0x1F;
+  byte overflow = pointers[1] & 0x1F;
+  byte readPointer = pointers[2] & 0x1F;
+
+  //Samples the FIFO dropped since the last check(), kept until getOverflowCount() is called
+  if (overflow > 0) fifoOverflow = (fifoOverflow + overflow > 0xFFFF) ? 0xFFFF : fifoOverflow + overflow;
 
   int numberOfSamples = 0;
 
-  //Do we have new data?
-  if (readPointer != writePointer)
+  //Do we have new data? The pointers are also equal when the FIFO is full, which is when it overflows.
+  if (readPointer != writePointer || overflow > 0)
   {
     //Calculate the number of readings we need to get from sensor
     numberOfSamples = writePointer - readPointer;
-    if (numberOfSamples < 0) numberOfSamples += 32; //Wrap condition
+    if (numberOfSamples <= 0) numberOfSamples += 32; //Wrap condition
+
+    //Only read what the buffer has room for, the rest waits in the part's FIFO for the next check()
+    //A callback takes each block as it is read, so then the buffer always has room
+    if (samplesCallback == NULL)
+    {
+      if (numberOfSamples > bufferSpace()) numberOfSamples = bufferSpace();
+      if (numberOfSamples == 0) return (0);
+    }
 
     //We now have the number of readings, now calc bytes to read
-    //For this example we are just doing Red and IR (3 bytes each)
+    //Each record is activeLEDs slots of 3 bytes each
     int bytesLeftToRead = numberOfSamples * activeLEDs * 3;
 
+    drainLeft = numberOfSamples;
+    drainMicros = micros();
+
     //Get ready to read a burst of data from the FIFO register
-    _i2cPort->beginTransmission(MAX30105_ADDRESS);
-    _i2cPort->write(MAX30105_FIFODATA);
-    _i2cPort->endTransmission();
+    if (writeBytes(_i2caddr, MAX30105_FIFODATA, NULL, 0) != MAX30105_I2C_OK)
+    {
+      if (autoRecover) recover();
+      return (0);
+    }
+    byte headBefore = sense.head;
+
+    //We may need to read as many as 384 bytes so we read in blocks no larger than maxReadSize
+    //maxReadSize defaults to I2C_BUFFER_LENGTH, 64 bytes for SAMD21, 32 bytes for Uno, and can be raised
+    //for platforms with bigger Wire buffers. Blocks are trimmed to whole records: each is its own
+    //transaction and a record is never split across the STOP between them.
+    byte recordBytes = activeLEDs * 3;
+    int blockBytes = readBlockBytes();
 
-    //We may need to read as many as 288 bytes so we read in blocks no larger than I2C_BUFFER_LENGTH
-    //I2C_BUFFER_LENGTH changes based on the platform. 64 bytes for SAMD21, 32 bytes for Uno.
-    //Wire.requestFrom() is limited to BUFFER_LENGTH which is 32 on the Uno
     while (bytesLeftToRead > 0)
     {
       int toGet = bytesLeftToRead;
-      if (toGet > I2C_BUFFER_LENGTH)
-      {
-        //If toGet is 32 this is bad because we read 6 bytes (Red+IR * 3 = 6) at a time
-        //32 % 6 = 2 left over. We don't want to request 32 bytes, we want to request 30.
-        //32 % 9 (Red+IR+GREEN) = 5 left over. We want to request 27.
-
-        toGet = I2C_BUFFER_LENGTH - (I2C_BUFFER_LENGTH % (activeLEDs * 3)); //Trim toGet to be a multiple of the samples we need to read
-      }
+      if (toGet > blockBytes) toGet = blockBytes;
 
       bytesLeftToRead -= toGet;
 
       //Request toGet number of bytes from sensor
-      _i2cPort->requestFrom(MAX30105_ADDRESS, toGet);
-      
-      while (toGet > 0)
+      //FIFO reads aren't retried, the part has already moved on. Keep the records that arrived whole.
+      if (_i2cPort->requestFrom((uint8_t)_i2caddr, (uint8_t)toGet) < toGet)
       {
-        sense.head++; //Advance the head of the storage struct
-        sense.head %= STORAGE_SIZE; //Wrap condition
-
-        byte temp[sizeof(uint32_t)]; //Array of 4 bytes that we will convert into long
-        uint32_t tempLong;
-
-        //Burst read three bytes - RED
-        temp[3] = 0;
-        temp[2] = _i2cPort->read();
-        temp[1] = _i2cPort->read();
-        temp[0] = _i2cPort->read();
-
-        //Convert array to long
-        memcpy(&tempLong, temp, sizeof(tempLong));
-		
-		tempLong &= 0x3FFFF; //Zero out all but 18 bits
-
-        sense.red[sense.head] = tempLong; //Store this reading into the sense array
-
-        if (activeLEDs > 1)
+        while (_i2cPort->available()) _i2cPort->read();
+        i2cStatus = MAX30105_I2C_SHORT_READ;
+#if defined(WIRE_HAS_TIMEOUT)
+        if (_i2cPort->getWireTimeoutFlag())
         {
-          //Burst read three more bytes - IR
-          temp[3] = 0;
-          temp[2] = _i2cPort->read();
-          temp[1] = _i2cPort->read();
-          temp[0] = _i2cPort->read();
-
-          //Convert array to long
-          memcpy(&tempLong, temp, sizeof(tempLong));
-
-		  tempLong &= 0x3FFFF; //Zero out all but 18 bits
-          
-		  sense.IR[sense.head] = tempLong;
-        }
-
-        if (activeLEDs > 2)
-        {
-          //Burst read three more bytes - Green
-          temp[3] = 0;
-          temp[2] = _i2cPort->read();
-          temp[1] = _i2cPort->read();
-          temp[0] = _i2cPort->read();
-
-          //Convert array to long
-          memcpy(&tempLong, temp, sizeof(tempLong));
-
-		  tempLong &= 0x3FFFF; //Zero out all but 18 bits
-
-          sense.green[sense.head] = tempLong;
+          _i2cPort->clearWireTimeoutFlag(); //Or the next unrelated short read is taken for a timeout
+          i2cStatus = MAX30105_I2C_TIMEOUT;
         }
+#endif
+        countI2CError();
+        if (autoRecover) recover(); //Clears the FIFO, the rest of this read is lost
+        return ((byte)(sense.head - headBefore));
+      }
 
-        toGet -= activeLEDs * 3;
+      //One decode loop per record width so the slot loop is unrolled
+      int records = toGet / recordBytes;
+      switch (activeLEDs)
+      {
+        case 1: readRecords<1>(records); break;
+        case 2: readRecords<2>(records); break;
+        case 3: readRecords<3>(records); break;
+        default: readRecords<4>(records); break;
       }
 
     } //End while (bytesLeftToRead > 0)
@@ -709,9 +1063,11 @@ bool MAX30105::safeCheck(uint8_t maxTimeToCheck)
   {
 	if(millis() - markTime > maxTimeToCheck) return(false);
 
-	if(check() == true) //We found new data!
+	if(check() > 0) //We found new data!
 	  return(true);
 
+	if(i2cStatus != MAX30105_I2C_OK) return(false); //check() has already retried and recovered, don't spin on a broken bus
+
 	delay(1);
   }
 }
@@ -720,7 +1076,9 @@ bool MAX30105::safeCheck(uint8_t maxTimeToCheck)
 void MAX30105::bitMask(uint8_t reg, uint8_t mask, uint8_t thing)
 {
   // Grab current register context
-  uint8_t originalContents = readRegister8(_i2caddr, reg);
+  // If it can't be read leave the register alone rather than write back a guess
+  uint8_t originalContents;
+  if (readRegister8(_i2caddr, reg, originalContents) != MAX30105_I2C_OK) return;
 
   // Zero-out the portions of the register we're interested in
   originalContents = originalContents & mask;
@@ -733,23 +1091,232 @@ void MAX30105::bitMask(uint8_t reg, uint8_t mask, uint8_t thing)
 // Low-level I2C Communication
 //
 uint8_t MAX30105::readRegister8(uint8_t address, uint8_t reg) {
-  _i2cPort->beginTransmission(address);
-  _i2cPort->write(reg);
-  _i2cPort->endTransmission(false);
+  uint8_t value;
+  if (readBytes(address, reg, &value, 1) == MAX30105_I2C_OK) return (value);
+
+  return (0); //Fail, getI2CStatus() says why
+}
+
+uint8_t MAX30105::readRegister8(uint8_t address, uint8_t reg, uint8_t &value) {
+  return (readBytes(address, reg, &value, 1));
+}
+
+uint8_t MAX30105::writeRegister8(uint8_t address, uint8_t reg, uint8_t value) {
+  return (writeBytes(address, reg, &value, 1));
+}
 
-  _i2cPort->requestFrom((uint8_t)address, (uint8_t)1); // Request 1 byte
-  if (_i2cPort->available())
+//Read consecutive registers in one transaction, the address auto increments
+//Returns false if fewer than length bytes came back
+bool MAX30105::readRegisters(uint8_t reg, uint8_t *values, uint8_t length) {
+  return (readBytes(_i2caddr, reg, values, length) == MAX30105_I2C_OK);
+}
+
+//Write consecutive registers in one transaction. length plus one must fit I2C_BUFFER_LENGTH.
+uint8_t MAX30105::writeRegisters(uint8_t reg, const uint8_t *values, uint8_t length) {
+  return (writeBytes(_i2caddr, reg, values, length));
+}
+
+//Register reads and writes are repeatable, so a failed one is tried again up to i2cRetries times
+uint8_t MAX30105::readBytes(uint8_t address, uint8_t reg, uint8_t *values, uint8_t length) {
+  uint8_t attempts = 0;
+  while ((i2cStatus = readAttempt(address, reg, values, length)) != MAX30105_I2C_OK)
   {
-    return(_i2cPort->read());
+    countI2CError();
+    if (attempts++ >= i2cRetries) break;
   }
+  return (i2cStatus);
+}
+
+uint8_t MAX30105::writeBytes(uint8_t address, uint8_t reg, const uint8_t *values, uint8_t length) {
+  uint8_t attempts = 0;
+  while ((i2cStatus = writeAttempt(address, reg, values, length, true)) != MAX30105_I2C_OK)
+  {
+    countI2CError();
+    if (attempts++ >= i2cRetries) return (i2cStatus);
+  }
+
+  if (address == _i2caddr) shadowWrite(reg, values, length);
+  return (i2cStatus);
+}
+
+uint8_t MAX30105::readAttempt(uint8_t address, uint8_t reg, uint8_t *values, uint8_t length) {
+  uint8_t status = writeAttempt(address, reg, NULL, 0, false);
+  if (status != MAX30105_I2C_OK) return (status);
 
-  return (0); //Fail
+  uint8_t received = _i2cPort->requestFrom((uint8_t)address, length);
+  uint8_t count = 0;
+  while (count < length && _i2cPort->available())
+    values[count++] = _i2cPort->read();
+  while (_i2cPort->available()) _i2cPort->read(); //Don't leave extra bytes for the next read
 
+  if (count == length) return (MAX30105_I2C_OK);
+#if defined(WIRE_HAS_TIMEOUT)
+  if (_i2cPort->getWireTimeoutFlag())
+  {
+    _i2cPort->clearWireTimeoutFlag();
+    return (MAX30105_I2C_TIMEOUT);
+  }
+#endif
+  return (received == 0 ? MAX30105_I2C_NACK : MAX30105_I2C_SHORT_READ);
 }
 
-void MAX30105::writeRegister8(uint8_t address, uint8_t reg, uint8_t value) {
+//Register address then length values. Without a stop the bus is kept for the read that follows.
+uint8_t MAX30105::writeAttempt(uint8_t address, uint8_t reg, const uint8_t *values, uint8_t length, bool stop) {
   _i2cPort->beginTransmission(address);
   _i2cPort->write(reg);
-  _i2cPort->write(value);
-  _i2cPort->endTransmission();
+  if (length > 0) _i2cPort->write(values, length);
+
+  //endTransmission(): 0 success, 2 address NACK, 3 data NACK, 5 timeout on cores that have one
+  switch (_i2cPort->endTransmission(stop))
+  {
+    case 0: return (MAX30105_I2C_OK);
+    case 2:
+    case 3: return (MAX30105_I2C_NACK);
+    case 5:
+#if defined(WIRE_HAS_TIMEOUT)
+      _i2cPort->clearWireTimeoutFlag();
+#endif
+      return (MAX30105_I2C_TIMEOUT);
+    default: return (MAX30105_I2C_ERROR);
+  }
+}
+
+void MAX30105::countI2CError(void) {
+  if (i2cErrors < 0xFFFF) i2cErrors++;
+}
+
+uint16_t MAX30105::getI2CErrorCount(void) {
+  uint16_t count = i2cErrors;
+  i2cErrors = 0;
+  return (count);
+}
+
+void MAX30105::setI2CRetries(uint8_t retries) {
+  i2cRetries = retries;
+}
+
+//A transaction that hangs, for example on a device holding SCL low, is abandoned after timeoutMicros
+//and the Wire hardware is reset. Cores without WIRE_HAS_TIMEOUT wait as long as their Wire library does.
+void MAX30105::setI2CTimeout(uint32_t timeoutMicros) {
+  i2cTimeout = timeoutMicros;
+  if (_i2cPort != NULL) applyI2CTimeout();
+}
+
+void MAX30105::applyI2CTimeout(void) {
+#if defined(WIRE_HAS_TIMEOUT)
+  _i2cPort->setWireTimeout(i2cTimeout, true);
+#endif
+}
+
+void MAX30105::setRecoveryPins(uint8_t sdaPin, uint8_t sclPin) {
+  recoverySDA = sdaPin;
+  recoverySCL = sclPin;
+}
+
+//A device reset or interrupted part way through sending a byte keeps driving SDA low and waits
+//for clocks that never come. Up to 9 clocks let it finish the byte, then a stop frees the bus.
+//Clocking the pins needs the Wire port released first, so it's only done on cores that have
+//Wire.end() (WIRE_HAS_END) and when the pins are known. The port is restarted either way.
+uint8_t MAX30105::recoverBus(void) {
+  bool stuck = false;
+
+#if defined(WIRE_HAS_END)
+  if (_i2cPort != NULL && recoverySDA != 0xFF && recoverySCL != 0xFF)
+  {
+    _i2cPort->end(); //Hand the pins back
+    pinMode(recoverySDA, INPUT_PULLUP);
+    pinMode(recoverySCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+
+    //Open drain: drive low, or let the pull up take the line high
+    for (uint8_t x = 0 ; x < 9 && digitalRead(recoverySDA) == LOW ; x++)
+    {
+      digitalWrite(recoverySCL, LOW);
+      pinMode(recoverySCL, OUTPUT);
+      delayMicroseconds(5);
+      pinMode(recoverySCL, INPUT_PULLUP);
+      delayMicroseconds(5);
+    }
+
+    //Stop condition, SDA rising while SCL is high
+    digitalWrite(recoverySDA, LOW);
+    pinMode(recoverySDA, OUTPUT);
+    delayMicroseconds(5);
+    pinMode(recoverySDA, INPUT_PULLUP);
+    delayMicroseconds(5);
+
+    stuck = (digitalRead(recoverySDA) == LOW || digitalRead(recoverySCL) == LOW);
+  }
+#endif
+
+  if (_i2cPort != NULL)
+  {
+    _i2cPort->begin();
+    _i2cPort->setClock(_i2cSpeed);
+    applyI2CTimeout();
+  }
+
+  i2cStatus = (stuck ? MAX30105_I2C_BUS_STUCK : MAX30105_I2C_OK);
+  return (i2cStatus);
+}
+
+//After an I2C error: free the bus, make sure the part still answers, and if it was reset
+//(brown out, hot plug) write back the configuration it had. The FIFO is cleared either way as a read
+//cut short may have left it part way through a record. Bounded: one bus recovery and at most
+//eight transactions, made without retries as check() has already retried the access that failed.
+//Returns MAX30105_I2C_OK when check() can carry on.
+uint8_t MAX30105::recover(void) {
+  uint8_t retries = i2cRetries;
+  i2cRetries = 0;
+  uint8_t status = recoverPart();
+  i2cRetries = retries;
+  return (status);
+}
+
+uint8_t MAX30105::recoverPart(void) {
+  if (recoverBus() != MAX30105_I2C_OK) return (i2cStatus);
+
+  uint8_t partID;
+  if (readRegister8(_i2caddr, MAX30105_PARTID, partID) != MAX30105_I2C_OK) return (i2cStatus);
+  if (partID != MAX_30105_EXPECTEDPARTID) return (i2cStatus = MAX30105_I2C_ERROR);
+
+  if (shadowValid == false)
+  {
+    //We never knew the configuration, all we can do is start the FIFO afresh
+    clearFIFO();
+    return (i2cStatus);
+  }
+
+  uint8_t image[MAX30105_CONFIG_LENGTH];
+  memcpy(image, configShadow, MAX30105_CONFIG_LENGTH);
+  uint8_t result = restoreConfig(image);
+  if (result == RESUME_FAILED) return (i2cStatus);
+
+  if (result == RESUME_WRITTEN)
+  {
+    //The interrupt enables and proximity threshold were lost along with the rest
+    uint8_t interrupts[2] = {interruptShadow[0], interruptShadow[1]};
+    if (writeRegisters(MAX30105_INTENABLE1, interrupts, 2) != MAX30105_I2C_OK) return (i2cStatus);
+    writeRegister8(_i2caddr, MAX30105_PROXINTTHRESH, proxThresholdShadow);
+  }
+
+  return (i2cStatus);
+}
+
+//Keep a copy of every configuration register written, for recover()
+void MAX30105::shadowWrite(uint8_t reg, const uint8_t *values, uint8_t length) {
+  for (uint8_t x = 0 ; x < length ; x++, reg++)
+  {
+    uint8_t value = values[x];
+
+    if (reg == MAX30105_INTENABLE1 || reg == MAX30105_INTENABLE2)
+      interruptShadow[reg - MAX30105_INTENABLE1] = value;
+    else if (reg >= MAX30105_FIFOCONFIG && reg < MAX30105_FIFOCONFIG + MAX30105_CONFIG_LENGTH)
+    {
+      if (reg == MAX30105_MODECONFIG) value &= MAX30105_RESET_MASK; //Writing back the reset bit would reset the part again
+      configShadow[reg - MAX30105_FIFOCONFIG] = value;
+    }
+    else if (reg == MAX30105_PROXINTTHRESH)
+      proxThresholdShadow = value;
+  }
 }
@@ -25,6 +25,22 @@
 #define I2C_SPEED_STANDARD        100000
 #define I2C_SPEED_FAST            400000
 
+//resume() results
+#define RESUME_FAILED             0 //Part ID didn't match, check wiring/power
+#define RESUME_WARM               1 //Configuration was intact, only the FIFO was cleared
+#define RESUME_WRITTEN            2 //Configuration was lost and has been written again
+
+//I2C results, returned by the status variants of the register functions and kept for getI2CStatus()
+#define MAX30105_I2C_OK           0
+#define MAX30105_I2C_NACK         1 //Nothing answered, check wiring/power
+#define MAX30105_I2C_SHORT_READ   2 //Fewer bytes came back than were asked for
+#define MAX30105_I2C_TIMEOUT      3 //The Wire library gave up waiting, usually a device holding the bus
+#define MAX30105_I2C_BUS_STUCK    4 //SDA was still low after clocking the bus out
+#define MAX30105_I2C_ERROR        5 //Any other Wire error, or a part that isn't a MAX30105
+
+#define MAX30105_I2C_RETRIES      2 //Default extra attempts at a failed register access
+#define MAX30105_I2C_TIMEOUT_US   25000 //Default Wire timeout, on cores that have one
+
 //Define the size of the I2C buffer based on the platform the user has
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
 
@@ -43,16 +59,49 @@
 
 #endif
 
+//Build with -DMAX30105_PACKED_STORAGE to keep buffered readings in 3 bytes instead of 4
+#if defined(MAX30105_PACKED_STORAGE)
+  #include "packedSamples.h"
+  typedef PackedSample sense_sample_t;
+#else
+  typedef uint32_t sense_sample_t;
+#endif
+
+//A block of samples handed to an onSamples() callback. Read it with the accessors, i is 0 to count - 1.
+//The samples stay in the driver's buffer, so a block is at most STORAGE_SIZE - 1 samples.
+struct SampleSpan
+{
+  const sense_sample_t *redRow; //Rows of the driver's buffer, NULL if the channel isn't in use
+  const sense_sample_t *irRow;
+  const sense_sample_t *greenRow;
+  uint8_t first; //Buffer position of sample 0
+  uint8_t mask;
+  uint8_t count;
+
+  //One check() can hand over several blocks. later is how many samples it reads after this one, so
+  //sample i was taken (count - 1 - i + later) sample periods before the newest sample of the check().
+  //checkMicros is micros() when check() found them, within a sample period of when the newest was taken.
+  uint8_t later;
+  uint32_t checkMicros;
+
+  uint32_t red(uint8_t i) const { return (redRow ? (uint32_t)redRow[(uint8_t)(first + i) & mask] : 0); }
+  uint32_t IR(uint8_t i) const { return (irRow ? (uint32_t)irRow[(uint8_t)(first + i) & mask] : 0); }
+  uint32_t green(uint8_t i) const { return (greenRow ? (uint32_t)greenRow[(uint8_t)(first + i) & mask] : 0); }
+};
+
+typedef void (*SamplesCallback)(const SampleSpan &samples, void *context);
+
 class MAX30105 {
  public: 
   MAX30105(void);
 
   boolean begin(TwoWire &wirePort = Wire, uint32_t i2cSpeed = I2C_SPEED_STANDARD, uint8_t i2caddr = MAX30105_ADDRESS);
 
+  //getRed(), getIR() and getGreen() throw away buffered samples and wait for a new one
   uint32_t getRed(void); //Returns immediate red value
   uint32_t getIR(void); //Returns immediate IR value
   uint32_t getGreen(void); //Returns immediate green value
-  bool safeCheck(uint8_t maxTimeToCheck); //Given a max amount of time, check for new data
+  bool safeCheck(uint8_t maxTimeToCheck); //Given a max amount of time, check for new data. Gives up early on an I2C error.
 
   // Configuration
   void softReset();
@@ -99,19 +148,40 @@ class MAX30105 {
   void setFIFOAlmostFull(uint8_t samples);
   
   //FIFO Reading
-  uint16_t check(void); //Checks for new data and fills FIFO
+  //Without an onSamples() callback check() only reads what fits in the sense buffer, STORAGE_SIZE - 1
+  //samples, and leaves the rest in the part's FIFO for the next call. Call it again once samples have
+  //been read with nextSample(). Example6 and Example9 call it once per loop() and read what it returned.
+  uint16_t check(void); //Checks for new data and fills FIFO. See MAX30105.cpp for how long it can block on I2C errors.
   uint8_t available(void); //Tells caller how many new samples are available (head - tail)
   void nextSample(void); //Advances the tail of the sense array
   uint32_t getFIFORed(void); //Returns the FIFO sample pointed to by tail
   uint32_t getFIFOIR(void); //Returns the FIFO sample pointed to by tail
   uint32_t getFIFOGreen(void); //Returns the FIFO sample pointed to by tail
+  uint32_t getFIFOSlot(uint8_t slotNumber); //Returns the FIFO sample of slot 1 to 4 pointed to by tail, for pilot or custom schedules
+  uint8_t getSlotCount(void) { return (activeLEDs); } //Number of slots in each FIFO record
+
+  //Have check() hand every block of new samples to callback as it is read. NULL to stop.
+  //context is passed back untouched, for example a pointer to the object that wants the samples.
+  //The callback runs inside check(), in whatever context called it, and its block is released
+  //when it returns. Don't use callbacks if check() is called from an interrupt: call check() from
+  //loop(), or leave the callback NULL and read samples with available()/nextSample() in loop().
+  void onSamples(SamplesCallback callback, void *context = NULL);
+
+  //I2C read size used to drain the FIFO
+  void setMaxReadSize(uint8_t bytes); //Largest requestFrom() the Wire library can take, default I2C_BUFFER_LENGTH
+  uint8_t getMaxReadSize(void) { return (maxReadSize); }
+  uint8_t discoverMaxReadSize(void); //Ask the Wire library how much it will buffer, and use that. 0 on an I2C error.
+  uint8_t transactionsFor(uint16_t samples); //requestFrom() calls check() needs to drain this many samples
 
   uint8_t getWritePointer(void);
   uint8_t getReadPointer(void);
+  uint8_t getFIFOCount(void); //Records waiting in the part's FIFO, 0 to 32. 32 if the pointers can't be read.
+  uint16_t getOverflowCount(void); //Samples dropped by a full FIFO since the last call, counted by check()
   void clearFIFO(void); //Sets the read/write pointers to zero
 
   //Proximity Mode Interrupt Threshold
   void setPROXINTTHRESH(uint8_t val);
+  void reenterProximityMode(void); //With PROXINT enabled, go back to pilot LED sensing until the threshold is crossed
 
   // Die Temperature
   float readTemperature();
@@ -123,32 +193,98 @@ class MAX30105 {
 
   // Setup the IC with user selectable settings
   void setup(byte powerLevel = 0x1F, byte sampleAverage = 4, byte ledMode = 3, int sampleRate = 400, int pulseWidth = 411, int adcRange = 4096);
+  // Or after waking: skip the reset and only write the settings if the part lost them
+  uint8_t resume(byte powerLevel = 0x1F, byte sampleAverage = 4, byte ledMode = 3, int sampleRate = 400, int pulseWidth = 411, int adcRange = 4096);
 
   // Low-level I2C communication
-  uint8_t readRegister8(uint8_t address, uint8_t reg);
-  void writeRegister8(uint8_t address, uint8_t reg, uint8_t value);
+  //Failed transactions are retried, and the result of the last one is kept for getI2CStatus()
+  uint8_t readRegister8(uint8_t address, uint8_t reg); //Returns 0 on failure, see getI2CStatus()
+  uint8_t readRegister8(uint8_t address, uint8_t reg, uint8_t &value); //Returns a MAX30105_I2C_ status
+  uint8_t writeRegister8(uint8_t address, uint8_t reg, uint8_t value); //Returns a MAX30105_I2C_ status
+  bool readRegisters(uint8_t reg, uint8_t *values, uint8_t length);
+  uint8_t writeRegisters(uint8_t reg, const uint8_t *values, uint8_t length); //Returns a MAX30105_I2C_ status
+
+  // I2C error handling
+  uint8_t getI2CStatus(void) { return (i2cStatus); } //Result of the last transaction, MAX30105_I2C_OK if it worked
+  uint16_t getI2CErrorCount(void); //Failed attempts since the last call, retried ones included
+  void setI2CRetries(uint8_t retries); //Extra attempts at a failed register access, default MAX30105_I2C_RETRIES
+  void setI2CTimeout(uint32_t timeoutMicros); //Bounds every transaction, on cores that define WIRE_HAS_TIMEOUT
+  void setAutoRecover(bool enable) { autoRecover = enable; } //Let check() call recover() after an I2C error, default on
+  void setRecoveryPins(uint8_t sdaPin, uint8_t sclPin); //Pins recoverBus() clocks, default the Wire port's SDA and SCL
+  uint8_t recoverBus(void); //Clock out a device holding SDA low and restart the Wire port
+  uint8_t recover(void); //recoverBus(), then check the part and give it back its configuration if it lost it
 
  private:
   TwoWire *_i2cPort; //The generic connection to user's chosen I2C hardware
   uint8_t _i2caddr;
-
-  //activeLEDs is the number of channels turned on, and can be 1 to 3. 2 is common for Red+IR.
-  byte activeLEDs; //Gets set during setup. Allows check() to calculate how many bytes to read from FIFO
+  uint32_t _i2cSpeed;
+
+  uint8_t i2cStatus; //Result of the last transaction
+  uint16_t i2cErrors; //Failed attempts, cleared by getI2CErrorCount()
+  uint8_t i2cRetries;
+  uint32_t i2cTimeout;
+  bool autoRecover;
+  uint8_t recoverySDA; //0xFF if unknown, then recoverBus() only restarts the port
+  uint8_t recoverySCL;
+
+  //Configuration as last written, so recover() can give it back to a part that was reset
+  uint8_t configShadow[11]; //Registers 0x08 to 0x12
+  uint8_t interruptShadow[2]; //Registers 0x02 and 0x03
+  uint8_t proxThresholdShadow;
+  bool shadowValid; //Set once softReset(), setup() or resume() has put the part in a known state
+
+  //activeLEDs is the number of slots in each FIFO record, and can be 1 to 4. 2 is common for Red+IR.
+  byte activeLEDs; //Follows setLEDMode() and enableSlot(). Allows check() to calculate how many bytes to read from FIFO
+
+  //Which slot holds each LED, so the FIFO can be decoded for any slot schedule
+  uint8_t ledModeSetting; //Last value given to setLEDMode()
+  uint8_t slotDevice[4]; //Device assigned to each slot by enableSlot()
+  uint8_t channelSlot[3]; //Slot (0 to 3) holding red, IR and green, 0xFF if none
   
   uint8_t revisionID; 
 
   void readRevisionID();
 
   void bitMask(uint8_t reg, uint8_t mask, uint8_t thing);
+
+  uint8_t maxReadSize; //Bytes per requestFrom() when draining the FIFO
+  uint16_t fifoOverflow; //Overflow counts read by check(), cleared by getOverflowCount()
+
+  SamplesCallback samplesCallback;
+  void *samplesContext;
+  void deliverSamples(byte first, uint8_t count);
+  uint8_t drainLeft; //Records the current check() has still to deliver
+  uint32_t drainMicros; //When it read the FIFO pointers
+
+  uint8_t readBytes(uint8_t address, uint8_t reg, uint8_t *values, uint8_t length);
+  uint8_t writeBytes(uint8_t address, uint8_t reg, const uint8_t *values, uint8_t length);
+  uint8_t readAttempt(uint8_t address, uint8_t reg, uint8_t *values, uint8_t length);
+  uint8_t writeAttempt(uint8_t address, uint8_t reg, const uint8_t *values, uint8_t length, bool stop);
+  void countI2CError(void);
+  void applyI2CTimeout(void);
+  void shadowWrite(uint8_t reg, const uint8_t *values, uint8_t length);
+  uint8_t restoreConfig(const uint8_t *image);
+  uint8_t recoverPart(void);
+
+  void updateSlotMap(void);
+  void configImage(uint8_t *image, byte powerLevel, byte sampleAverage, byte ledMode, int sampleRate, int pulseWidth, int adcRange);
+  void loadSlotMap(const uint8_t *image);
+  template <uint8_t SLOTS> void readRecords(int records); //Decode records with no per slot branches
+  uint32_t slotSample(uint8_t channel, byte index);
+  uint8_t bufferSpace(void);
+  uint8_t readBlockBytes(void);
+  bool checkNewest(uint8_t maxTimeToCheck);
  
-   #define STORAGE_SIZE 4 //Each long is 4 bytes so limit this to fit on your micro
+   #define STORAGE_SIZE 4 //Each long is 4 bytes so limit this to fit on your micro. Must be a power of two.
+  //check() is the only writer of head and never stores into a slot the reader hasn't released.
+  //Only the reading side, nextSample() and getRed()/getIR()/getGreen(), writes tail. With the
+  //ordering in spscRing.h check() can run from an interrupt while loop() reads samples, as long as
+  //no onSamples() callback is set: a callback would run in the interrupt too.
   typedef struct Record
   {
-    uint32_t red[STORAGE_SIZE];
-    uint32_t IR[STORAGE_SIZE];
-    uint32_t green[STORAGE_SIZE];
-    byte head;
-    byte tail;
+    sense_sample_t slot[4][STORAGE_SIZE]; //Readings in FIFO slot order, see channelSlot
+    byte head; //Count of records written, newest is at head & (STORAGE_SIZE - 1)
+    byte tail; //Count of records consumed
   } sense_struct; //This is our circular buffer of readings from the sensor
 
   sense_struct sense;
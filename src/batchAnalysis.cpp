@@ -0,0 +1,84 @@
+/*
+ Batch analysis of recorded PPG sessions on Linux hosts
+ SparkFun Electronics
+
+ Work-stealing pool used by BatchAnalysis. See batchAnalysis.h.
+*/
+
+#if defined(__linux__)
+
+#include <thread>
+
+#include "batchAnalysis.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+  _threads = threads;
+  if (_threads == 0) _threads = std::thread::hardware_concurrency();
+  if (_threads == 0) _threads = 1; //Core count unknown
+
+  _queues = std::vector<WorkQueue>(_threads);
+}
+
+//Run every task once, returns when all are done
+void WorkStealingPool::run(size_t taskCount, const std::function<void(size_t task, unsigned worker)> &work)
+{
+  //Give each worker a contiguous share to start with
+  for (unsigned x = 0 ; x < _threads ; x++)
+  {
+    size_t first = taskCount * x / _threads;
+    size_t last = taskCount * (x + 1) / _threads;
+    std::lock_guard<std::mutex> guard(_queues[x].lock);
+    _queues[x].tasks.clear();
+    for (size_t task = first ; task < last ; task++)
+      _queues[x].tasks.push_back(task);
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(_threads - 1);
+  for (unsigned x = 1 ; x < _threads ; x++)
+    threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, x, std::cref(work)));
+
+  workerLoop(0, work); //The calling thread is worker 0
+
+  for (size_t x = 0 ; x < threads.size() ; x++)
+    threads[x].join();
+}
+
+void WorkStealingPool::workerLoop(unsigned worker, const std::function<void(size_t, unsigned)> &work)
+{
+  size_t task;
+  while (takeTask(worker, task))
+    work(task, worker);
+}
+
+//Pop from the back of our own queue, otherwise steal from the front of another
+//No tasks are added during a run so finding every queue empty means we are done
+bool WorkStealingPool::takeTask(unsigned worker, size_t &task)
+{
+  {
+    std::lock_guard<std::mutex> guard(_queues[worker].lock);
+    if (!_queues[worker].tasks.empty())
+    {
+      task = _queues[worker].tasks.back();
+      _queues[worker].tasks.pop_back();
+      return (true);
+    }
+  }
+
+  for (unsigned x = 1 ; x < _threads ; x++)
+  {
+    WorkQueue &victim = _queues[(worker + x) % _threads];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty())
+    {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      return (true);
+    }
+  }
+
+  return (false);
+}
+
+#endif //__linux__
@@ -0,0 +1,164 @@
+/*
+ Batch analysis of recorded PPG sessions on Linux hosts
+ SparkFun Electronics
+
+ Reprocesses many recorded sessions through checkForBeat() and the SpO2
+ algorithm using every core. Beats come from checkForBeat(detector, sample), the
+ call device firmware makes, so they can be checked against what it reported.
+ Sessions are handed to a work-stealing pool, each worker owns its own
+ BeatDetector and SpO2 work arrays, and every session starts from fresh
+ algorithm state. The result of a session therefore does not depend on which
+ worker ran it, and results are merged in session order.
+
+ Only built on Linux hosts.
+*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+
+#include "heartRate.h"
+#include "spo2_algorithm.h"
+#include "ppgChannel.h"
+
+//One recorded session of samples
+struct PPGSession
+{
+  const uint32_t *ir;
+  const uint32_t *red;
+  uint32_t length; //Number of samples in each of ir and red
+};
+
+struct PPGSessionResult
+{
+  std::vector<uint32_t> beats; //Sample index of every beat found by checkForBeat()
+  std::vector<SpO2Reading> readings; //One per window step
+};
+
+//Totals over all sessions, merged in session order
+struct PPGBatchSummary
+{
+  uint64_t samples;
+  uint64_t beats;
+  uint64_t readings;
+  uint64_t validSpO2;
+  uint64_t validHeartRate;
+  double averageSpO2; //Over valid readings
+  double averageHeartRate; //Over valid readings
+};
+
+//Runs tasks 0 to taskCount-1 on a set of threads. Each thread starts with a
+//contiguous share of the tasks, takes work from the back of its own queue and
+//steals from the front of the others' when it runs dry.
+class WorkStealingPool
+{
+ public:
+  WorkStealingPool(unsigned threads = 0); //0 uses every core
+
+  unsigned threadCount(void) const { return _threads; }
+  void run(size_t taskCount, const std::function<void(size_t task, unsigned worker)> &work);
+
+ private:
+  struct WorkQueue
+  {
+    std::mutex lock;
+    std::deque<size_t> tasks;
+  };
+
+  bool takeTask(unsigned worker, size_t &task);
+  void workerLoop(unsigned worker, const std::function<void(size_t, unsigned)> &work);
+
+  unsigned _threads;
+  std::vector<WorkQueue> _queues;
+};
+
+//FREQ and SIZE select the SpO2 window as in maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>()
+template <int32_t FREQ = FreqS, int32_t SIZE = BUFFER_SIZE>
+class BatchAnalysis
+{
+ public:
+  BatchAnalysis(unsigned threads = 0) : _pool(threads), _workers(_pool.threadCount()), _windowStep(FREQ) {}
+
+  //Samples between SpO2 windows. Default is one second, as in Example8_SPO2.
+  void setWindowStep(uint32_t samples) { _windowStep = samples > 0 ? samples : 1; }
+  unsigned threadCount(void) const { return _pool.threadCount(); }
+
+  //Analyze count sessions into results[0 .. count-1]
+  void analyze(const PPGSession *sessions, size_t count, PPGSessionResult *results)
+  {
+    _pool.run(count, [&](size_t task, unsigned worker) {
+      analyzeSession(sessions[task], results[task], _workers[worker]);
+    });
+  }
+
+  static PPGBatchSummary summarize(const PPGSession *sessions, const PPGSessionResult *results, size_t count)
+  {
+    PPGBatchSummary summary = {0, 0, 0, 0, 0, 0.0, 0.0};
+    double spo2Sum = 0, heartRateSum = 0;
+
+    for (size_t x = 0 ; x < count ; x++)
+    {
+      summary.samples += sessions[x].length;
+      summary.beats += results[x].beats.size();
+      summary.readings += results[x].readings.size();
+      for (size_t r = 0 ; r < results[x].readings.size() ; r++)
+      {
+        const SpO2Reading &reading = results[x].readings[r];
+        if (reading.spo2Valid) { summary.validSpO2++; spo2Sum += reading.spo2; }
+        if (reading.heartRateValid) { summary.validHeartRate++; heartRateSum += reading.heartRate; }
+      }
+    }
+
+    if (summary.validSpO2) summary.averageSpO2 = spo2Sum / summary.validSpO2;
+    if (summary.validHeartRate) summary.averageHeartRate = heartRateSum / summary.validHeartRate;
+    return (summary);
+  }
+
+ private:
+  struct WorkerState
+  {
+    maxim_spo2_workspace<SIZE> spo2;
+  };
+
+  void analyzeSession(const PPGSession &session, PPGSessionResult &result, WorkerState &state)
+  {
+    BeatDetector detector; //Fresh state so the result does not depend on the worker
+    PPGChannel ir(FREQ); //Keeps the SpO2 window mean
+
+    result.beats.clear();
+    result.readings.clear();
+
+    //One pass: every sample goes through the channel once, a window is analyzed whenever one ends on this sample
+    for (uint32_t x = 0 ; x < session.length ; x++)
+    {
+      ir.update(session.ir[x]);
+      if (x >= SIZE) ir.retire(session.ir[x - SIZE]);
+
+      if (checkForBeat(detector, (int32_t)session.ir[x]) == true)
+        result.beats.push_back(x);
+
+      if (x + 1 < SIZE || (x + 1 - SIZE) % _windowStep != 0) continue;
+
+      uint32_t start = x + 1 - SIZE;
+      SpO2Reading reading;
+      reading.sample = start;
+      maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(const_cast<uint32_t *>(session.ir + start), SIZE,
+          const_cast<uint32_t *>(session.red + start), &reading.spo2, &reading.spo2Valid,
+          &reading.heartRate, &reading.heartRateValid, ir, &state.spo2);
+      result.readings.push_back(reading);
+    }
+  }
+
+  WorkStealingPool _pool;
+  std::vector<WorkerState> _workers;
+  uint32_t _windowStep;
+};
+
+#endif //__linux__
@@ -0,0 +1,115 @@
+/*
+ Best Channel Beat Detection
+ SparkFun Electronics
+
+ See channelArbiter.h
+*/
+
+#include "channelArbiter.h"
+
+ChannelArbiter::ChannelArbiter(uint16_t sampleRate)
+{
+  _sampleRate = sampleRate > 0 ? sampleRate : 1;
+  _channels = ARBITER_RED_MASK | ARBITER_IR_MASK | ARBITER_GREEN_MASK;
+  _margin = 25;
+  _hold = _sampleRate * 3;
+
+  for (uint8_t x = 0 ; x < 3 ; x++)
+    _quality[x] = SignalQuality(_sampleRate);
+  _quality[ARBITER_GREEN].setDCRange(ARBITER_GREEN_MIN_DC, 250000); //Green is absorbed far more, its DC is lower
+
+  reset();
+}
+
+void ChannelArbiter::reset(void)
+{
+  for (uint8_t x = 0 ; x < 3 ; x++)
+  {
+    _quality[x].reset();
+    _score[x] = 0;
+  }
+  _detector = BeatDetector();
+
+  //Start on IR, as the examples do, unless it isn't allowed
+  _channel = ARBITER_IR;
+  if ((_channels & ARBITER_IR_MASK) == 0) _channel = (_channels & ARBITER_GREEN_MASK) ? ARBITER_GREEN : ARBITER_RED;
+  _candidate = _channel;
+  _candidateCount = 0;
+  _sample = 0;
+  _changed = false;
+}
+
+void ChannelArbiter::setChannels(uint8_t channels)
+{
+  _channels = channels & (ARBITER_RED_MASK | ARBITER_IR_MASK | ARBITER_GREEN_MASK);
+  if (_channels == 0) _channels = ARBITER_IR_MASK;
+  reset();
+}
+
+void ChannelArbiter::setHysteresis(uint8_t marginPercent, uint16_t holdSamples)
+{
+  _margin = marginPercent;
+  _hold = holdSamples;
+}
+
+bool ChannelArbiter::channelChanged(void)
+{
+  bool changed = _changed;
+  _changed = false;
+  return (changed);
+}
+
+uint16_t ChannelArbiter::score(uint8_t channel) const
+{
+  const SignalQuality &quality = _quality[channel];
+  uint8_t status = quality.status();
+  if (status & (SQ_NO_CONTACT | SQ_SATURATED)) return (0);
+
+  int32_t dc = quality.getDC();
+  int32_t amplitude = quality.getACAmplitude();
+  if (dc <= 0 || amplitude <= 0) return (0);
+
+  uint32_t perfusion = (uint32_t)amplitude * 10000 / (uint32_t)dc; //0.01% units
+  if (status & SQ_IRREGULAR) perfusion >>= 2;
+  return (perfusion > 0xFFFF ? 0xFFFF : perfusion);
+}
+
+bool ChannelArbiter::update(uint32_t red, uint32_t ir, uint32_t green)
+{
+  uint32_t samples[3] = {red, ir, green};
+
+  //Score every allowed channel, remember the best
+  uint8_t best = _channel;
+  for (uint8_t x = 0 ; x < 3 ; x++)
+  {
+    if ((_channels & (1 << x)) == 0) continue;
+    _quality[x].update(samples[x]);
+    _score[x] = score(x);
+    if (_score[x] > _score[best]) best = x;
+  }
+
+  //Switch only after the same channel has been clearly better for a while
+  if (best != _channel && (uint32_t)_score[best] * 100 >= (uint32_t)_score[_channel] * (100 + _margin))
+  {
+    if (best != _candidate)
+    {
+      _candidate = best;
+      _candidateCount = 0;
+    }
+    if (++_candidateCount >= _hold)
+    {
+      _channel = best;
+      _candidateCount = 0;
+      _detector = BeatDetector(); //Its filters were following the old channel
+      _changed = true;
+    }
+  }
+  else
+  {
+    _candidate = _channel;
+    _candidateCount = 0;
+  }
+
+  _sample = samples[_channel];
+  return (checkForBeat(_detector, _sample));
+}
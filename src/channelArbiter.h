@@ -0,0 +1,78 @@
+/*
+ Best Channel Beat Detection
+ SparkFun Electronics
+
+ The examples feed checkForBeat() with IR, but on the wrist green usually has a
+ far bigger pulse relative to its DC level. ChannelArbiter watches red, IR and
+ green with a SignalQuality each (a few adds and compares a sample) and runs the
+ beat detector on only the best one.
+
+ A channel's score is its perfusion index (AC amplitude / DC) in 0.01% units,
+ quartered if its zero crossings are irregular and 0 if it has no contact or is
+ clipping. The arbiter moves to another channel only when that channel has scored
+ at least margin percent better for holdSamples samples in a row, so it doesn't
+ flip between two similar channels. The beat detector is restarted on a switch.
+
+ Red and IR start with SignalQuality's default contact window of 50000 to 250000
+ counts DC. Green reads well below red and IR at the same LED current, so its
+ window starts at ARBITER_GREEN_MIN_DC instead. Change any channel's limits with
+ getQuality(channel), for example getQuality(ARBITER_GREEN).setDCRange(...).
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "heartRate.h"
+#include "signalQuality.h"
+
+#define ARBITER_RED           0
+#define ARBITER_IR            1
+#define ARBITER_GREEN         2
+
+//Channel mask bits for setChannels()
+#define ARBITER_RED_MASK      (1 << ARBITER_RED)
+#define ARBITER_IR_MASK       (1 << ARBITER_IR)
+#define ARBITER_GREEN_MASK    (1 << ARBITER_GREEN)
+
+#define ARBITER_GREEN_MIN_DC  5000 //Lowest green DC taken as skin contact, as LEDGainControl's no contact level
+
+class ChannelArbiter {
+ public:
+  ChannelArbiter(uint16_t sampleRate = 25);
+
+  void reset(void);
+  bool update(uint32_t red, uint32_t ir, uint32_t green); //Call with every sample, returns true on a beat in the chosen channel
+
+  uint8_t getChannel(void) const { return (_channel); } //ARBITER_RED, ARBITER_IR or ARBITER_GREEN
+  bool channelChanged(void); //True once after each switch. Restart anything timing beats.
+  uint32_t getSample(void) const { return (_sample); } //Latest sample of the chosen channel
+  uint16_t getScore(uint8_t channel) const { return (channel < 3 ? _score[channel] : 0); }
+  const SignalQuality &getQuality(uint8_t channel) const { return (_quality[channel < 3 ? channel : _channel]); }
+  SignalQuality &getQuality(uint8_t channel) { return (_quality[channel < 3 ? channel : _channel]); } //To set a channel's DC range, clip level or minimum AC
+
+  void setChannels(uint8_t channels); //ARBITER_*_MASK bits to choose from, default all three
+  void setHysteresis(uint8_t marginPercent, uint16_t holdSamples); //Default 25% better for 3 seconds
+
+ private:
+  uint16_t _sampleRate;
+  uint8_t _channels;
+  uint8_t _margin;
+  uint16_t _hold;
+
+  SignalQuality _quality[3];
+  uint16_t _score[3];
+  BeatDetector _detector;
+
+  uint8_t _channel;
+  uint8_t _candidate;
+  uint16_t _candidateCount; //Samples in a row _candidate has beaten _channel by the margin
+  uint32_t _sample;
+  bool _changed;
+
+  uint16_t score(uint8_t channel) const;
+};
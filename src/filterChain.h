@@ -0,0 +1,209 @@
+/*
+ Compile-time filter chains
+ SparkFun Electronics
+
+ checkForBeat() and the SpO2 code each remove DC and smooth the signal with hand
+ written loops. FilterChain builds the same kind of pipeline from stages chosen
+ as template arguments, for example:
+
+   FilterChain<DCBlocker<int32_t, 4>, Biquad<int32_t, BIQUAD_PPG_25HZ>, MovingAverage<int32_t, 4>> filter;
+   int32_t ac = filter.process(sample);
+
+ Every stage is inline, so the compiler fuses the chain into one pass: each sample
+ goes through all the stages before the next is read, and nothing is buffered
+ between stages. A stage keeps only its own state (a moving average its window,
+ an FIR its taps).
+
+ Stages take the sample type as their first argument. int32_t runs in fixed point
+ and suits micros without an FPU. float uses the same coefficients and gives the
+ reference answer. Coefficients are integers, biquads in Q14 (1.0 = 16384), so
+ the two versions of a chain are built from one set of constants.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+//Scaling shared by the stages: shifts in fixed point, multiplies in float
+template <uint8_t SHIFT> inline int32_t filter_scale_up(int32_t x) { return (x * ((int32_t)1 << SHIFT)); }
+template <uint8_t SHIFT> inline float filter_scale_up(float x) { return (x * (float)(1UL << SHIFT)); }
+template <uint8_t SHIFT> inline int32_t filter_scale_down(int32_t x) { return (x >> SHIFT); }
+template <uint8_t SHIFT> inline float filter_scale_down(float x) { return (x * (1.0f / (1UL << SHIFT))); }
+
+//Removes the DC level tracked with a time constant of 2^SHIFT samples, as averageDCEstimator() does.
+//In fixed point the level keeps FRACTION extra bits. Samples up to 2^(31 - FRACTION) fit.
+template <typename T, uint8_t SHIFT = 4, uint8_t FRACTION = 8>
+class DCBlocker {
+ public:
+  typedef T sample_type;
+
+  DCBlocker(void) { reset(); }
+  void reset(void) { _level = 0; _primed = false; }
+
+  T process(T x)
+  {
+    //Start at the first sample instead of climbing up from 0
+    if (_primed == false)
+    {
+      _level = filter_scale_up<FRACTION>(x);
+      _primed = true;
+    }
+    _level += filter_scale_down<SHIFT>(filter_scale_up<FRACTION>(x) - _level);
+    return (x - filter_scale_down<FRACTION>(_level));
+  }
+
+ private:
+  T _level;
+  bool _primed;
+};
+
+//y = (B0 x[n] + B1 x[n-1] + B2 x[n-2] - A1 y[n-1] - A2 y[n-2]) / 16384, coefficients in Q14 with a0 = 1
+//Fixed point sums in 64 bits so an 18-bit sample can't overflow at any gain.
+template <typename T, int32_t B0, int32_t B1, int32_t B2, int32_t A1, int32_t A2>
+class Biquad {
+ public:
+  typedef T sample_type;
+
+  Biquad(void) { reset(); }
+  void reset(void) { _x1 = _x2 = _y1 = _y2 = 0; }
+
+  T process(T x)
+  {
+    T y = filter(x);
+    _x2 = _x1;
+    _x1 = x;
+    _y2 = _y1;
+    _y1 = y;
+    return (y);
+  }
+
+ private:
+  T _x1, _x2, _y1, _y2;
+
+  int32_t filter(int32_t x) const
+  {
+    int64_t sum = (int64_t)B0 * x + (int64_t)B1 * _x1 + (int64_t)B2 * _x2 - (int64_t)A1 * _y1 - (int64_t)A2 * _y2;
+    return ((int32_t)((sum + 8192) >> 14));
+  }
+
+  float filter(float x) const
+  {
+    const float scale = 1.0f / 16384;
+    return ((B0 * scale) * x + (B1 * scale) * _x1 + (B2 * scale) * _x2 - (A1 * scale) * _y1 - (A2 * scale) * _y2);
+  }
+};
+
+//Band-pass biquads for 0.5 to 4Hz (30 to 240bpm) at common sample rates, for Biquad<T, BIQUAD_PPG_25HZ>
+#define BIQUAD_PPG_25HZ   4932, 0, -4932, -21473, 6521
+#define BIQUAD_PPG_50HZ   2941, 0, -2941, -26463, 10502
+#define BIQUAD_PPG_100HZ  1621, 0, -1621, -29409, 13142
+
+//Mean of the last N samples, kept as a running sum
+template <typename T, uint8_t N = 4>
+class MovingAverage {
+ public:
+  typedef T sample_type;
+
+  static_assert(N > 0, "MovingAverage needs at least one sample");
+
+  MovingAverage(void) { reset(); }
+  void reset(void) { memset(_window, 0, sizeof(_window)); _sum = 0; _position = 0; _filled = 0; }
+
+  T process(T x)
+  {
+    _sum += x - _window[_position];
+    _window[_position] = x;
+    if (++_position == N) _position = 0;
+    if (_filled < N) _filled++;
+    return (_sum / (T)_filled); //Mean of what there is until the window fills
+  }
+
+ private:
+  T _window[N];
+  T _sum;
+  uint8_t _position;
+  uint8_t _filled;
+};
+
+//FIR filter with integer taps, scaled down by 2^SHIFT: y = (C0 x[n] + C1 x[n-1] + ...) >> SHIFT
+template <typename T, uint8_t SHIFT, int32_t... C>
+class FIRFilter {
+ public:
+  typedef T sample_type;
+  static const uint8_t TAPS = sizeof...(C);
+
+  static_assert(TAPS > 0, "FIRFilter needs at least one tap");
+
+  FIRFilter(void) { reset(); }
+  void reset(void) { memset(_history, 0, sizeof(_history)); _position = 0; }
+
+  T process(T x)
+  {
+    _history[_position] = x;
+
+    T sum = 0;
+    uint8_t index = _position;
+    for (uint8_t tap = 0 ; tap < TAPS ; tap++)
+    {
+      sum += (T)taps[tap] * _history[index];
+      index = (index == 0 ? TAPS - 1 : index - 1);
+    }
+
+    if (++_position == TAPS) _position = 0;
+    return (filter_scale_down<SHIFT>(sum));
+  }
+
+ private:
+  static constexpr int32_t taps[TAPS] = {C...};
+  T _history[TAPS];
+  uint8_t _position;
+};
+
+template <typename T, uint8_t SHIFT, int32_t... C>
+constexpr int32_t FIRFilter<T, SHIFT, C...>::taps[FIRFilter<T, SHIFT, C...>::TAPS];
+
+//The stages run in the order given. process() takes one sample, or a block in a single pass.
+template <typename... STAGES>
+class FilterChain;
+
+template <>
+class FilterChain<> {
+ public:
+  void reset(void) {}
+  template <typename T> T process(T x) { return (x); }
+};
+
+template <typename FIRST, typename... REST>
+class FilterChain<FIRST, REST...> {
+ public:
+  typedef typename FIRST::sample_type sample_type;
+
+  void reset(void) { _first.reset(); _rest.reset(); }
+
+  sample_type process(sample_type x) { return (_rest.process(_first.process(x))); }
+
+  //Filter count samples from in to out, which may be the same array. in can be any sample type, such as the
+  //uint32_t or uint16_t buffers the SpO2 examples fill.
+  template <typename IN>
+  void process(const IN *in, sample_type *out, uint16_t count)
+  {
+    for (uint16_t x = 0 ; x < count ; x++)
+      out[x] = process((sample_type)in[x]);
+  }
+
+  FIRST &first(void) { return (_first); } //The stages, to reset or inspect one
+  FilterChain<REST...> &rest(void) { return (_rest); }
+
+ private:
+  FIRST _first;
+  FilterChain<REST...> _rest;
+};
+
+//DC blocker, 0.5 to 4Hz band-pass and 4 point moving average for 25 samples a second: FilterChain for
+//checkForBeat() and SpO2 style processing. PPGFilter25<int32_t> in fixed point, PPGFilter25<float> in float.
+template <typename T>
+using PPGFilter25 = FilterChain<DCBlocker<T, 4>, Biquad<T, BIQUAD_PPG_25HZ>, MovingAverage<T, 4>>;
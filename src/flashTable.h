@@ -0,0 +1,26 @@
+/*
+ Constant lookup tables kept in program memory
+ SparkFun Electronics
+
+ On AVR a plain const array is copied into SRAM at startup. Tables declared
+ with FLASH_TABLE stay in flash there, and must be read with readTable8() and
+ readTable16(). On every other platform const data is already addressable in
+ place, so FLASH_TABLE is empty and the readers are plain loads.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+ #include <avr/pgmspace.h>
+ #define FLASH_TABLE PROGMEM
+
+ static inline uint8_t readTable8(const uint8_t *entry) { return (pgm_read_byte(entry)); }
+ static inline uint16_t readTable16(const uint16_t *entry) { return (pgm_read_word(entry)); }
+#else
+ #define FLASH_TABLE
+
+ static inline uint8_t readTable8(const uint8_t *entry) { return (*entry); }
+ static inline uint16_t readTable16(const uint16_t *entry) { return (*entry); }
+#endif
@@ -56,56 +56,63 @@
 */
 
 #include "heartRate.h"
+#include "flashTable.h"
 
-int16_t IR_AC_Max = 20;
-int16_t IR_AC_Min = -20;
+static BeatDetector sharedDetector; //Used by checkForBeat(sample)
 
-int16_t IR_AC_Signal_Current = 0;
-int16_t IR_AC_Signal_Previous;
-int16_t IR_AC_Signal_min = 0;
-int16_t IR_AC_Signal_max = 0;
-int16_t IR_Average_Estimated;
-
-int16_t positiveEdge = 0;
-int16_t negativeEdge = 0;
-int32_t ir_avg_reg = 0;
-
-int16_t cbuf[32];
-uint8_t offset = 0;
-
-static const uint16_t FIRCoeffs[12] = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
+static const uint16_t FIRCoeffs[12] FLASH_TABLE = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
 
 //  Heart Rate Monitor functions takes a sample value and the sample number
 //  Returns true if a beat is detected
 //  A running average of four samples is recommended for display on the screen.
 bool checkForBeat(int32_t sample)
+{
+  return(checkForBeat(sharedDetector, sample));
+}
+
+//  State of checkForBeat(sample). Sketches that read IR_AC_Max, IR_AC_Min and the other
+//  globals this used to keep can read sharedBeatDetector().IR_AC_Max instead.
+BeatDetector &sharedBeatDetector(void)
+{
+  return(sharedDetector);
+}
+
+//  Same as above with the state held in the given detector
+bool checkForBeat(BeatDetector &d, int32_t sample)
+{
+  //  Process next data sample
+  d.IR_Average_Estimated = averageDCEstimator(&d.ir_avg_reg, sample);
+  return(checkForBeatAC(d, lowPassFIRFilter(d, sample - d.IR_Average_Estimated)));
+}
+
+//  Beat detection on a sample that has already been through averageDCEstimator() and lowPassFIRFilter()
+//  Lets a shared preprocessing stage (see ppgChannel.h) do the filtering once for every consumer
+bool checkForBeatAC(BeatDetector &d, int16_t acSignal)
 {
   bool beatDetected = false;
 
   //  Save current state
-  IR_AC_Signal_Previous = IR_AC_Signal_Current;
+  d.IR_AC_Signal_Previous = d.IR_AC_Signal_Current;
   
   //This is good to view for debugging
   //Serial.print("Signal_Current: ");
-  //Serial.println(IR_AC_Signal_Current);
+  //Serial.println(d.IR_AC_Signal_Current);
 
-  //  Process next data sample
-  IR_Average_Estimated = averageDCEstimator(&ir_avg_reg, sample);
-  IR_AC_Signal_Current = lowPassFIRFilter(sample - IR_Average_Estimated);
+  d.IR_AC_Signal_Current = acSignal;
 
   //  Detect positive zero crossing (rising edge)
-  if ((IR_AC_Signal_Previous < 0) & (IR_AC_Signal_Current >= 0))
+  if ((d.IR_AC_Signal_Previous < 0) & (d.IR_AC_Signal_Current >= 0))
   {
   
-    IR_AC_Max = IR_AC_Signal_max; //Adjust our AC max and min
-    IR_AC_Min = IR_AC_Signal_min;
+    d.IR_AC_Max = d.IR_AC_Signal_max; //Adjust our AC max and min
+    d.IR_AC_Min = d.IR_AC_Signal_min;
 
-    positiveEdge = 1;
-    negativeEdge = 0;
-    IR_AC_Signal_max = 0;
+    d.positiveEdge = 1;
+    d.negativeEdge = 0;
+    d.IR_AC_Signal_max = 0;
 
-    //if ((IR_AC_Max - IR_AC_Min) > 100 & (IR_AC_Max - IR_AC_Min) < 1000)
-    if ((IR_AC_Max - IR_AC_Min) > 20 & (IR_AC_Max - IR_AC_Min) < 1000)
+    //if ((d.IR_AC_Max - d.IR_AC_Min) > 100 & (d.IR_AC_Max - d.IR_AC_Min) < 1000)
+    if ((d.IR_AC_Max - d.IR_AC_Min) > 20 & (d.IR_AC_Max - d.IR_AC_Min) < 1000)
     {
       //Heart beat!!!
       beatDetected = true;
@@ -113,23 +120,23 @@ bool checkForBeat(int32_t sample)
   }
 
   //  Detect negative zero crossing (falling edge)
-  if ((IR_AC_Signal_Previous > 0) & (IR_AC_Signal_Current <= 0))
+  if ((d.IR_AC_Signal_Previous > 0) & (d.IR_AC_Signal_Current <= 0))
   {
-    positiveEdge = 0;
-    negativeEdge = 1;
-    IR_AC_Signal_min = 0;
+    d.positiveEdge = 0;
+    d.negativeEdge = 1;
+    d.IR_AC_Signal_min = 0;
   }
 
   //  Find Maximum value in positive cycle
-  if (positiveEdge & (IR_AC_Signal_Current > IR_AC_Signal_Previous))
+  if (d.positiveEdge & (d.IR_AC_Signal_Current > d.IR_AC_Signal_Previous))
   {
-    IR_AC_Signal_max = IR_AC_Signal_Current;
+    d.IR_AC_Signal_max = d.IR_AC_Signal_Current;
   }
 
   //  Find Minimum value in negative cycle
-  if (negativeEdge & (IR_AC_Signal_Current < IR_AC_Signal_Previous))
+  if (d.negativeEdge & (d.IR_AC_Signal_Current < d.IR_AC_Signal_Previous))
   {
-    IR_AC_Signal_min = IR_AC_Signal_Current;
+    d.IR_AC_Signal_min = d.IR_AC_Signal_Current;
   }
   
   return(beatDetected);
@@ -145,17 +152,28 @@ int16_t averageDCEstimator(int32_t *p, uint16_t x)
 //  Low Pass FIR Filter
 int16_t lowPassFIRFilter(int16_t din)
 {  
-  cbuf[offset] = din;
+  return(lowPassFIRFilter(sharedDetector, din));
+}
+
+int16_t lowPassFIRFilter(BeatDetector &d, int16_t din)
+{  
+  return(lowPassFIRFilter(d.cbuf, &d.offset, din));
+}
+
+//  cbuf must hold 32 samples
+int16_t lowPassFIRFilter(int16_t *cbuf, uint8_t *offset, int16_t din)
+{  
+  cbuf[*offset] = din;
 
-  int32_t z = mul16(FIRCoeffs[11], cbuf[(offset - 11) & 0x1F]);
+  int32_t z = mul16(readTable16(&FIRCoeffs[11]), cbuf[(*offset - 11) & 0x1F]);
   
   for (uint8_t i = 0 ; i < 11 ; i++)
   {
-    z += mul16(FIRCoeffs[i], cbuf[(offset - i) & 0x1F] + cbuf[(offset - 22 + i) & 0x1F]);
+    z += mul16(readTable16(&FIRCoeffs[i]), cbuf[(*offset - i) & 0x1F] + cbuf[(*offset - 22 + i) & 0x1F]);
   }
 
-  offset++;
-  offset %= 32; //Wrap condition
+  (*offset)++;
+  *offset %= 32; //Wrap condition
 
   return(z >> 15);
 }
@@ -55,13 +55,41 @@
 * 
 */
 
+#pragma once
+
 #if (ARDUINO >= 100)
  #include "Arduino.h"
 #else
  #include "WProgram.h"
 #endif
 
+//State of one beat detector. Keep one per signal to run several detectors at once.
+//checkForBeat(sample) without a detector uses a single shared instance.
+struct BeatDetector
+{
+  int16_t IR_AC_Max = 20;
+  int16_t IR_AC_Min = -20;
+
+  int16_t IR_AC_Signal_Current = 0;
+  int16_t IR_AC_Signal_Previous = 0;
+  int16_t IR_AC_Signal_min = 0;
+  int16_t IR_AC_Signal_max = 0;
+  int16_t IR_Average_Estimated = 0;
+
+  int16_t positiveEdge = 0;
+  int16_t negativeEdge = 0;
+  int32_t ir_avg_reg = 0;
+
+  int16_t cbuf[32] = {0};
+  uint8_t offset = 0;
+};
+
 bool checkForBeat(int32_t sample);
+bool checkForBeat(BeatDetector &detector, int32_t sample);
+BeatDetector &sharedBeatDetector(void); //The detector checkForBeat(sample) uses, in place of the old IR_AC_Max etc. globals
+bool checkForBeatAC(BeatDetector &detector, int16_t acSignal); //Takes an already DC removed and filtered sample
 int16_t averageDCEstimator(int32_t *p, uint16_t x);
 int16_t lowPassFIRFilter(int16_t din);
+int16_t lowPassFIRFilter(BeatDetector &detector, int16_t din);
+int16_t lowPassFIRFilter(int16_t *cbuf, uint8_t *offset, int16_t din);
 int32_t mul16(int16_t x, int16_t y);
@@ -0,0 +1,203 @@
+/*
+ Closed Loop LED Current Control (Automatic Gain)
+ SparkFun Electronics
+
+ See ledGainControl.h
+*/
+
+#include "ledGainControl.h"
+
+//ADC range field of the particle sensing config register, as MAX30105_ADCRANGE_2048 to _16384
+static const uint8_t AGC_ADC_RANGE_SHIFT = 5;
+
+LEDGainControl::LEDGainControl(void)
+{
+  _sensor = NULL;
+  _channels = 2;
+  _sampleRate = 25;
+
+  _low = 80000;
+  _high = 180000;
+  _minAmplitude = 0x02;
+  _maxAmplitude = 0xFF;
+  _holdOff = 25;
+  _noContact = 5000;
+  _rangeControl = false;
+
+  _amplitude[AGC_RED] = _amplitude[AGC_IR] = _amplitude[AGC_GREEN] = 0x1F;
+  _adcRange = 1;
+  _dc[AGC_RED] = _dc[AGC_IR] = _dc[AGC_GREEN] = -1;
+
+  _sampleCount = 0;
+  _lastWrite = 0;
+  _settleUntil = 0;
+  _lastEffect = 0;
+
+  _logHead = 0;
+  _logTail = 0;
+}
+
+//Start from the settings setup() was given
+void LEDGainControl::begin(MAX30105 &sensor, uint8_t ledMode, uint8_t powerLevel, uint8_t adcRange, uint16_t sampleRate)
+{
+  _sensor = &sensor;
+  _channels = (ledMode >= 1 && ledMode <= 3) ? ledMode : 2;
+  _sampleRate = sampleRate > 0 ? sampleRate : 1;
+  _holdOff = _sampleRate;
+
+  _amplitude[AGC_RED] = _amplitude[AGC_IR] = _amplitude[AGC_GREEN] = powerLevel;
+  _adcRange = adcRange & 0x03;
+  _dc[AGC_RED] = _dc[AGC_IR] = _dc[AGC_GREEN] = -1;
+
+  _sampleCount = 0;
+  _lastWrite = 0;
+  _settleUntil = 0;
+  _lastEffect = 0;
+  _logHead = _logTail = 0;
+}
+
+void LEDGainControl::setTargetWindow(uint32_t low, uint32_t high)
+{
+  _low = low;
+  _high = high > low ? high : low + 1;
+}
+
+void LEDGainControl::setAmplitudeLimits(uint8_t minimum, uint8_t maximum)
+{
+  _minAmplitude = minimum > 0 ? minimum : 1; //Zero would leave nothing to scale from
+  _maxAmplitude = maximum > _minAmplitude ? maximum : _minAmplitude;
+}
+
+void LEDGainControl::setHoldOff(uint16_t samples)
+{
+  _holdOff = samples;
+}
+
+void LEDGainControl::setNoContactLevel(uint32_t level)
+{
+  _noContact = level;
+}
+
+void LEDGainControl::enableADCRangeControl(bool enable)
+{
+  _rangeControl = enable;
+}
+
+bool LEDGainControl::update(uint32_t red, uint32_t ir, uint32_t green)
+{
+  uint32_t sample[3] = { red & 0x3FFFF, ir & 0x3FFFF, green & 0x3FFFF };
+  uint32_t now = _sampleCount++;
+
+  if (_sensor == NULL) return (false); //begin() not called
+  if (now < _settleUntil) return (false); //Still draining samples taken before the last change
+
+  //DC estimate, same time constant as averageDCEstimator(). Reloaded after a change.
+  for (uint8_t x = 0 ; x < _channels ; x++)
+  {
+    if (_dc[x] < 0) _dc[x] = (int32_t)sample[x] << 8;
+    _dc[x] += (((int32_t)sample[x] << 8) - _dc[x]) >> 4;
+  }
+
+  if (now - _lastWrite < _holdOff) return (false);
+
+  //Work out the new settings before writing anything
+  uint8_t amplitude[3];
+  bool anyHigh = false; //A channel is too bright even at minimum current
+  bool allLow = true; //Every channel in contact is too dim even at maximum current
+  bool inContact = false;
+
+  for (uint8_t x = 0 ; x < _channels ; x++)
+  {
+    uint32_t dc = _dc[x] >> 8;
+    amplitude[x] = _amplitude[x];
+    if (dc < _noContact) continue; //No finger, don't turn the LED up to find one
+
+    inContact = true;
+    if (dc > _high || dc < _low) amplitude[x] = nextAmplitude(_amplitude[x], dc);
+
+    if (dc > _high && _amplitude[x] <= _minAmplitude) anyHigh = true;
+    if (!(dc < _low && _amplitude[x] >= _maxAmplitude)) allLow = false;
+  }
+
+  uint8_t adcRange = _adcRange;
+  if (_rangeControl == true && inContact == true)
+  {
+    if (anyHigh == true && adcRange < 3) adcRange++; //Coarser LSB, counts halve
+    else if (allLow == true && adcRange > 0) adcRange--; //Finer LSB, counts double
+  }
+
+  bool changed[4] = { false, false, false, false };
+  bool anyChanged = false;
+
+  for (uint8_t x = 0 ; x < _channels ; x++)
+  {
+    if (amplitude[x] == _amplitude[x]) continue;
+    writeAmplitude(x, amplitude[x]);
+    changed[x] = anyChanged = true;
+  }
+
+  if (adcRange != _adcRange)
+  {
+    _adcRange = adcRange;
+    _sensor->setADCRange(adcRange << AGC_ADC_RANGE_SHIFT);
+    changed[AGC_ADC_RANGE] = anyChanged = true;
+  }
+
+  if (anyChanged == false) return (false);
+
+  //Taken at the old setting: the samples still in the library buffer, the records waiting in the part's
+  //FIFO when the writes were made, and the conversion in progress
+  uint32_t effect = now + _sensor->available() + _sensor->getFIFOCount() + 2;
+
+  for (uint8_t x = 0 ; x < 3 ; x++)
+    if (changed[x] == true) logChange(x, _amplitude[x], effect);
+  if (changed[AGC_ADC_RANGE] == true) logChange(AGC_ADC_RANGE, _adcRange, effect);
+
+  _lastWrite = now;
+  _settleUntil = effect;
+  _lastEffect = effect;
+  for (uint8_t x = 0 ; x < 3 ; x++) _dc[x] = -1; //Measure again at the new setting
+  return (true);
+}
+
+//Scale the amplitude so the DC lands mid window, limited to 2x either way per step
+uint8_t LEDGainControl::nextAmplitude(uint8_t amplitude, uint32_t dc)
+{
+  if (amplitude == 0) amplitude = 1;
+  uint32_t target = (_low + _high) / 2;
+  uint32_t wanted = (uint32_t)amplitude * target / (dc > 0 ? dc : 1);
+
+  if (wanted > (uint32_t)amplitude * 2) wanted = (uint32_t)amplitude * 2;
+  if (wanted < (uint32_t)amplitude / 2) wanted = amplitude / 2;
+  if (wanted == amplitude) wanted = (dc < _low) ? amplitude + 1 : amplitude - 1; //Always move when outside the window
+
+  if (wanted < _minAmplitude) wanted = _minAmplitude;
+  if (wanted > _maxAmplitude) wanted = _maxAmplitude;
+  return (wanted);
+}
+
+void LEDGainControl::writeAmplitude(uint8_t channel, uint8_t amplitude)
+{
+  _amplitude[channel] = amplitude;
+  if (channel == AGC_RED) _sensor->setPulseAmplitudeRed(amplitude);
+  else if (channel == AGC_IR) _sensor->setPulseAmplitudeIR(amplitude);
+  else _sensor->setPulseAmplitudeGreen(amplitude);
+}
+
+//The oldest entry is dropped if the log is full
+void LEDGainControl::logChange(uint8_t channel, uint8_t value, uint32_t effect)
+{
+  _log[_logHead].sample = effect;
+  _log[_logHead].channel = channel;
+  _log[_logHead].value = value;
+  _logHead = (_logHead + 1) & (AGC_LOG_SIZE - 1);
+  if (_logHead == _logTail) _logTail = (_logTail + 1) & (AGC_LOG_SIZE - 1);
+}
+
+bool LEDGainControl::nextChange(GainChange &change)
+{
+  if (_logHead == _logTail) return (false);
+  change = _log[_logTail];
+  _logTail = (_logTail + 1) & (AGC_LOG_SIZE - 1);
+  return (true);
+}
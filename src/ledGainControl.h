@@ -0,0 +1,103 @@
+/*
+ Closed Loop LED Current Control (Automatic Gain)
+ SparkFun Electronics
+
+ setup() gives every LED the same powerLevel and nothing changes it afterwards,
+ so depending on skin tone and how the sensor is held the signal either clips
+ the 18-bit ADC or sits down in the noise. LEDGainControl watches the DC level
+ of each channel as samples are drained and moves the LED pulse amplitudes
+ (and optionally the ADC range) to keep the DC inside a target window:
+
+  - Nothing happens while the DC is inside the window (hysteresis)
+  - Outside it the amplitude is scaled towards the middle of the window, at most
+    doubling or halving per step, so the LED runs at the lowest current that
+    still uses the ADC well
+  - Register writes are at least holdOff samples apart
+  - Samples converted with the old setting that are still buffered, in the
+    library or in the part's FIFO, are skipped before the DC is measured again
+
+ Every change is logged with the index of the first sample taken at the new
+ setting so a consumer can restart its analysis window there.
+
+ Call update() once per sample, after nextSample(), with the values just read.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "MAX30105.h"
+
+#define AGC_RED             0
+#define AGC_IR              1
+#define AGC_GREEN           2
+#define AGC_ADC_RANGE       3 //Used in GainChange.channel for ADC range changes
+
+#define AGC_LOG_SIZE        8 //Gain changes kept until read with nextChange()
+
+struct GainChange
+{
+  uint32_t sample; //Index of the first sample taken with the new setting
+  uint8_t channel; //AGC_RED, AGC_IR, AGC_GREEN or AGC_ADC_RANGE
+  uint8_t value; //New pulse amplitude, or ADC range 0 to 3 (2048, 4096, 8192, 16384nA)
+};
+
+class LEDGainControl {
+ public:
+  LEDGainControl(void);
+
+  //ledMode and powerLevel as given to setup(). adcRange is 0 to 3 for 2048 to 16384nA full scale.
+  void begin(MAX30105 &sensor, uint8_t ledMode = 2, uint8_t powerLevel = 0x1F, uint8_t adcRange = 1, uint16_t sampleRate = 25);
+
+  bool update(uint32_t red, uint32_t ir = 0, uint32_t green = 0); //Returns true if a register was written
+
+  void setTargetWindow(uint32_t low, uint32_t high); //Default 80000 to 180000 counts
+  void setAmplitudeLimits(uint8_t minimum, uint8_t maximum); //Default 0x02 to 0xFF
+  void setHoldOff(uint16_t samples); //Minimum samples between changes, default one second
+  void setNoContactLevel(uint32_t level); //Below this DC the channel is left alone, default 5000
+  void enableADCRangeControl(bool enable = true); //Off by default
+
+  uint8_t getAmplitude(uint8_t channel) const { return (channel < 3 ? _amplitude[channel] : 0); }
+  uint8_t getADCRange(void) const { return (_adcRange); }
+  int32_t getDC(uint8_t channel) const { return (channel < 3 && _dc[channel] >= 0 ? _dc[channel] >> 8 : 0); }
+  uint32_t getSampleCount(void) const { return (_sampleCount); }
+  bool settling(void) const { return (_sampleCount < _settleUntil); } //Samples still from before the last change
+
+  uint8_t changesAvailable(void) const { return ((_logHead - _logTail) & (AGC_LOG_SIZE - 1)); }
+  bool nextChange(GainChange &change); //Oldest unread change, false if none
+  uint32_t lastChangeSample(void) const { return (_lastEffect); }
+
+ private:
+  MAX30105 *_sensor;
+  uint8_t _channels;
+  uint16_t _sampleRate;
+
+  uint32_t _low;
+  uint32_t _high;
+  uint8_t _minAmplitude;
+  uint8_t _maxAmplitude;
+  uint16_t _holdOff;
+  uint32_t _noContact;
+  bool _rangeControl;
+
+  uint8_t _amplitude[3];
+  uint8_t _adcRange;
+  int32_t _dc[3]; //DC estimates, 8 fractional bits, -1 until loaded
+
+  uint32_t _sampleCount;
+  uint32_t _lastWrite;
+  uint32_t _settleUntil;
+  uint32_t _lastEffect;
+
+  GainChange _log[AGC_LOG_SIZE];
+  uint8_t _logHead;
+  uint8_t _logTail;
+
+  uint8_t nextAmplitude(uint8_t amplitude, uint32_t dc);
+  void writeAmplitude(uint8_t channel, uint8_t amplitude);
+  void logChange(uint8_t channel, uint8_t value, uint32_t effect);
+};
@@ -0,0 +1,84 @@
+/*
+ Packed 18-bit Sample Storage
+ SparkFun Electronics
+
+ See packedSamples.h
+*/
+
+#include "packedSamples.h"
+
+void packSamples(PackedSample *dest, const uint32_t *src, uint16_t count)
+{
+  for (uint16_t x = 0 ; x < count ; x++)
+    dest[x] = src[x];
+}
+
+void unpackSamples(uint32_t *dest, const PackedSample *src, uint16_t count)
+{
+  for (uint16_t x = 0 ; x < count ; x++)
+    dest[x] = src[x];
+}
+
+void pack18(uint8_t *packed, uint32_t first, const uint32_t *src, uint16_t count)
+{
+  //Single samples up to a group boundary
+  while (count > 0 && (first & 3) != 0)
+  {
+    set18(packed, first++, *src++);
+    count--;
+  }
+
+  //Whole groups: 4 samples into 9 bytes
+  uint8_t *p = packed + (first >> 2) * 9;
+  while (count >= 4)
+  {
+    uint32_t v0 = src[0] & 0x3FFFF;
+    uint32_t v1 = src[1] & 0x3FFFF;
+    uint32_t v2 = src[2] & 0x3FFFF;
+    uint32_t v3 = src[3] & 0x3FFFF;
+
+    p[0] = v0;
+    p[1] = v0 >> 8;
+    p[2] = (v0 >> 16) | (v1 << 2);
+    p[3] = v1 >> 6;
+    p[4] = (v1 >> 14) | (v2 << 4);
+    p[5] = v2 >> 4;
+    p[6] = (v2 >> 12) | (v3 << 6);
+    p[7] = v3 >> 2;
+    p[8] = v3 >> 10;
+
+    p += 9;
+    src += 4;
+    first += 4;
+    count -= 4;
+  }
+
+  while (count-- > 0)
+    set18(packed, first++, *src++);
+}
+
+void unpack18(uint32_t *dest, const uint8_t *packed, uint32_t first, uint16_t count)
+{
+  while (count > 0 && (first & 3) != 0)
+  {
+    *dest++ = get18(packed, first++);
+    count--;
+  }
+
+  const uint8_t *p = packed + (first >> 2) * 9;
+  while (count >= 4)
+  {
+    dest[0] = (p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)(p[2] & 0x03) << 16));
+    dest[1] = ((p[2] >> 2) | ((uint32_t)p[3] << 6) | ((uint32_t)(p[4] & 0x0F) << 14));
+    dest[2] = ((p[4] >> 4) | ((uint32_t)p[5] << 4) | ((uint32_t)(p[6] & 0x3F) << 12));
+    dest[3] = ((p[6] >> 6) | ((uint32_t)p[7] << 2) | ((uint32_t)p[8] << 10));
+
+    p += 9;
+    dest += 4;
+    first += 4;
+    count -= 4;
+  }
+
+  while (count-- > 0)
+    *dest++ = get18(packed, first++);
+}
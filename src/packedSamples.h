@@ -0,0 +1,83 @@
+/*
+ Packed 18-bit Sample Storage
+ SparkFun Electronics
+
+ Readings are 18 bits but are usually kept in uint32_t, wasting 14 bits of every
+ sample, or in uint16_t on AVR, losing the top 2. Two lossless alternatives:
+
+  - PackedSample: 3 bytes that convert to and from uint32_t. Use it anywhere a
+    sample type is a template parameter, such as the SpO2 window
+    (maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(PackedSample *, ...)) or
+    PulseMonitor<FREQ, SIZE, PackedSample>. 25% smaller than uint32_t. The
+    PPGChannel overload of the SpO2 code needs uint32_t, so with PackedSample
+    the window mean is summed from the window.
+    Build with -DMAX30105_PACKED_STORAGE and the driver's sample buffer uses it too.
+
+  - Bit packed: 4 samples in 9 bytes (2.25 bytes a sample, 44% smaller than
+    uint32_t) for history that is read back in blocks. PACKED18_BYTES(n) gives
+    the buffer size. Pack and unpack whole groups of 4 with pack18()/unpack18(),
+    or single samples with get18()/set18().
+
+ Sample i of a bit packed buffer starts at bit 18 * i, least significant bit first.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+struct PackedSample
+{
+  uint8_t b[3]; //Little endian
+
+  PackedSample(void) = default;
+  PackedSample(uint32_t value) { *this = value; }
+
+  PackedSample &operator=(uint32_t value)
+  {
+    b[0] = value;
+    b[1] = value >> 8;
+    b[2] = value >> 16;
+    return (*this);
+  }
+
+  operator uint32_t(void) const { return (b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16)); }
+};
+
+static_assert(sizeof(PackedSample) == 3, "PackedSample must not be padded");
+
+//Bytes needed to bit pack n samples
+#define PACKED18_BYTES(n)   (((uint32_t)(n) * 18 + 7) / 8)
+
+//Whole array conversions between uint32_t and PackedSample
+void packSamples(PackedSample *dest, const uint32_t *src, uint16_t count);
+void unpackSamples(uint32_t *dest, const PackedSample *src, uint16_t count);
+
+//Bit packed blocks. first is the index of the first sample in the packed buffer.
+//Runs of whole groups of 4 starting on a multiple of 4 take the fast path.
+void pack18(uint8_t *packed, uint32_t first, const uint32_t *src, uint16_t count);
+void unpack18(uint32_t *dest, const uint8_t *packed, uint32_t first, uint16_t count);
+
+//Single samples of a bit packed buffer
+static inline uint32_t get18(const uint8_t *packed, uint32_t index)
+{
+  uint32_t bit = index * 18;
+  const uint8_t *p = packed + (bit >> 3);
+  //A sample starts at bit 0, 2, 4 or 6 of a byte so always lies within 3 bytes
+  return (((p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)) >> (bit & 7)) & 0x3FFFF);
+}
+
+static inline void set18(uint8_t *packed, uint32_t index, uint32_t value)
+{
+  uint32_t bit = index * 18;
+  uint8_t *p = packed + (bit >> 3);
+  uint8_t shift = bit & 7;
+  uint32_t word = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  word = (word & ~(0x3FFFFUL << shift)) | ((value & 0x3FFFF) << shift);
+  p[0] = word;
+  p[1] = word >> 8;
+  p[2] = word >> 16;
+}
@@ -0,0 +1,213 @@
+/*
+ Streaming Particle Detection
+ SparkFun Electronics
+
+ See particleDetector.h
+*/
+
+#include "particleDetector.h"
+
+ParticleDetector::ParticleDetector(uint8_t channels)
+{
+  _channels = channels & (PARTICLE_RED_MASK | PARTICLE_IR_MASK | PARTICLE_GREEN_MASK);
+  _factor = 24;
+  _minimum = 20;
+  _debounceOn = 2;
+  _debounceOff = 4;
+  _maxDuration = 2048;
+  _baselineShift = 10;
+  _noiseShift = 10;
+
+  reset();
+}
+
+void ParticleDetector::begin(MAX30105 &sensor)
+{
+  sensor.onSamples(samplesReceived, this);
+}
+
+void ParticleDetector::samplesReceived(const SampleSpan &samples, void *context)
+{
+  static_cast<ParticleDetector *>(context)->process(samples);
+}
+
+void ParticleDetector::reset(void)
+{
+  for (uint8_t x = 0 ; x < 3 ; x++)
+  {
+    _channel[x].baseline = -1; //Loaded from the first sample
+    _channel[x].noise = 0;
+    _channel[x].state = PARTICLE_IDLE;
+    _channel[x].run = 0;
+    _channel[x].count = 0;
+  }
+
+  _sampleCount = 0;
+  //Give the noise estimate two time constants to come up before detecting against it
+  uint8_t longest = _baselineShift > _noiseShift ? _baselineShift : _noiseShift;
+  _settleUntil = 2UL << longest;
+
+  _logHead = 0;
+  _logTail = 0;
+  _dropped = 0;
+}
+
+void ParticleDetector::setChannels(uint8_t channels)
+{
+  _channels = channels & (PARTICLE_RED_MASK | PARTICLE_IR_MASK | PARTICLE_GREEN_MASK);
+}
+
+void ParticleDetector::setThreshold(uint8_t factor, uint32_t minimum)
+{
+  _factor = factor;
+  _minimum = minimum;
+}
+
+void ParticleDetector::setDebounce(uint8_t on, uint8_t off)
+{
+  _debounceOn = on > 0 ? on : 1;
+  _debounceOff = off > 0 ? off : 1;
+}
+
+void ParticleDetector::setMaxDuration(uint16_t samples)
+{
+  _maxDuration = samples;
+}
+
+void ParticleDetector::setTimeConstants(uint8_t baselineShift, uint8_t noiseShift)
+{
+  if (baselineShift < 1) baselineShift = 1;
+  if (baselineShift > PARTICLE_FRACTION) baselineShift = PARTICLE_FRACTION;
+  if (noiseShift < 1) noiseShift = 1;
+  if (noiseShift > PARTICLE_FRACTION) noiseShift = PARTICLE_FRACTION;
+  _baselineShift = baselineShift;
+  _noiseShift = noiseShift;
+}
+
+//Each channel runs over the whole block in turn so its state stays in registers.
+//Events from one block are therefore logged channel by channel.
+void ParticleDetector::process(const SampleSpan &samples)
+{
+  if ((_channels & PARTICLE_RED_MASK) && samples.redRow)
+    processChannel(PARTICLE_RED, samples.redRow, samples.first, samples.mask, samples.count);
+  if ((_channels & PARTICLE_IR_MASK) && samples.irRow)
+    processChannel(PARTICLE_IR, samples.irRow, samples.first, samples.mask, samples.count);
+  if ((_channels & PARTICLE_GREEN_MASK) && samples.greenRow)
+    processChannel(PARTICLE_GREEN, samples.greenRow, samples.first, samples.mask, samples.count);
+
+  _sampleCount += samples.count;
+}
+
+void ParticleDetector::update(uint32_t red, uint32_t ir, uint32_t green)
+{
+  if (_channels & PARTICLE_RED_MASK) step(PARTICLE_RED, red, _sampleCount);
+  if (_channels & PARTICLE_IR_MASK) step(PARTICLE_IR, ir, _sampleCount);
+  if (_channels & PARTICLE_GREEN_MASK) step(PARTICLE_GREEN, green, _sampleCount);
+
+  _sampleCount++;
+}
+
+void ParticleDetector::processChannel(uint8_t channel, const sense_sample_t *row, uint8_t first, uint8_t mask, uint8_t count)
+{
+  for (uint8_t x = 0 ; x < count ; x++)
+    step(channel, row[(uint8_t)(first + x) & mask], _sampleCount + x);
+}
+
+void ParticleDetector::step(uint8_t channel, uint32_t sample, uint32_t index)
+{
+  Channel &c = _channel[channel];
+  int32_t level = (int32_t)(sample & 0x3FFFF) << PARTICLE_FRACTION; //Readings are 18 bits
+
+  if (c.baseline < 0)
+  {
+    c.baseline = level;
+    return;
+  }
+
+  int32_t difference = level - c.baseline;
+  int32_t deviation = difference >> PARTICLE_FRACTION;
+  uint32_t threshold = (((uint32_t)(c.noise >> PARTICLE_FRACTION) * _factor) >> 2) + _minimum;
+  bool over = (deviation > (int32_t)threshold);
+
+  if (index < _settleUntil) over = false; //Only track the background while settling
+
+  if (c.state == PARTICLE_IDLE)
+  {
+    if (over == false)
+    {
+      //Background: follow it
+      c.baseline += difference >> _baselineShift;
+      if (difference < 0) difference = -difference;
+      c.noise += (difference - c.noise) >> _noiseShift;
+      return;
+    }
+
+    c.state = PARTICLE_RISING;
+    c.run = 0;
+    c.start = index;
+    c.peak = 0;
+  }
+
+  if (c.state == PARTICLE_RISING)
+  {
+    if (over == false)
+    {
+      c.state = PARTICLE_IDLE; //Too short, a noise spike
+      return;
+    }
+
+    if ((uint32_t)deviation > c.peak) c.peak = deviation;
+    if (++c.run < _debounceOn) return;
+
+    c.state = PARTICLE_EVENT;
+    c.run = 0;
+    return;
+  }
+
+  //PARTICLE_EVENT
+  if (deviation > 0 && (uint32_t)deviation > c.peak) c.peak = deviation;
+
+  if (index - c.start >= _maxDuration)
+  {
+    //Not a particle, the background has changed. Start again from here.
+    c.baseline = level;
+    c.state = PARTICLE_IDLE;
+    return;
+  }
+
+  if (deviation * 2 > (int32_t)threshold)
+  {
+    c.run = 0; //Still above the release level
+    return;
+  }
+
+  if (++c.run < _debounceOff) return;
+
+  c.state = PARTICLE_IDLE;
+  c.count++;
+  logEvent(channel, c.start, index - c.run + 1 - c.start, c.peak);
+}
+
+void ParticleDetector::logEvent(uint8_t channel, uint32_t start, uint16_t duration, uint32_t peak)
+{
+  uint8_t next = (_logHead + 1) & (PARTICLE_LOG_SIZE - 1);
+  if (next == _logTail)
+  {
+    if (_dropped < 0xFFFF) _dropped++; //Keep the oldest unread events
+    return;
+  }
+
+  _log[_logHead].sample = start;
+  _log[_logHead].duration = duration;
+  _log[_logHead].peak = peak;
+  _log[_logHead].channel = channel;
+  _logHead = next;
+}
+
+bool ParticleDetector::nextEvent(ParticleEvent &event)
+{
+  if (_logHead == _logTail) return (false);
+  event = _log[_logTail];
+  _logTail = (_logTail + 1) & (PARTICLE_LOG_SIZE - 1);
+  return (true);
+}
@@ -0,0 +1,121 @@
+/*
+ Streaming Particle Detection
+ SparkFun Electronics
+
+ A particle passing through the beam scatters extra LED light back into the
+ photodiode, giving a short positive step above the background count. For each
+ enabled channel ParticleDetector keeps:
+  - a slow baseline (first order IIR) of the background count
+  - a noise estimate, the mean absolute deviation from the baseline
+ A sample is over threshold when it is above the baseline by more than
+ noise * factor / 4 + minimum. An event starts after debounceOn samples in a row
+ over threshold and ends after debounceOff samples in a row under half of it. The
+ baseline and noise are held while over threshold so an event doesn't raise them.
+ An excursion lasting longer than the maximum duration is a change of background
+ (something moved in front of the sensor) and the baseline is reloaded instead.
+
+ Work per sample per channel is a subtract, an abs, a multiply and a few shifts
+ and compares, so it keeps up with 3200 samples per second on a Cortex-M0.
+ Feed whole FIFO blocks with process(), or attach it to the sensor with begin()
+ so check() feeds it.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "MAX30105.h"
+
+#define PARTICLE_RED          0
+#define PARTICLE_IR           1
+#define PARTICLE_GREEN        2
+
+//Channel mask bits for begin() and setChannels()
+#define PARTICLE_RED_MASK     (1 << PARTICLE_RED)
+#define PARTICLE_IR_MASK      (1 << PARTICLE_IR)
+#define PARTICLE_GREEN_MASK   (1 << PARTICLE_GREEN)
+
+#define PARTICLE_LOG_SIZE     8 //Events kept until read with nextEvent()
+
+struct ParticleEvent
+{
+  uint32_t sample; //Index of the first sample over threshold
+  uint16_t duration; //Samples from the first over threshold to the last
+  uint32_t peak; //Largest count above the baseline
+  uint8_t channel; //PARTICLE_RED, PARTICLE_IR or PARTICLE_GREEN
+};
+
+class ParticleDetector {
+ public:
+  ParticleDetector(uint8_t channels = PARTICLE_IR_MASK);
+
+  void begin(MAX30105 &sensor); //Receive every block from check() through onSamples()
+  void reset(void); //Start again from a new baseline
+
+  void process(const SampleSpan &samples); //A block of samples. Channels missing from the span are skipped.
+  void update(uint32_t red, uint32_t ir = 0, uint32_t green = 0); //A single sample
+
+  void setChannels(uint8_t channels); //PARTICLE_*_MASK bits, default IR only
+  void setThreshold(uint8_t factor, uint32_t minimum); //Over noise * factor / 4 + minimum. Default 24 (6x noise) and 20 counts.
+  void setDebounce(uint8_t on, uint8_t off); //Samples in a row to start and to end an event. Default 2 and 4.
+  void setMaxDuration(uint16_t samples); //Longer excursions reload the baseline. Default 2048.
+  void setTimeConstants(uint8_t baselineShift, uint8_t noiseShift); //Filter lengths of 2^shift samples, 1 to 12. Default 10 and 10.
+
+  uint32_t getBaseline(uint8_t channel) const { return (channel < 3 && _channel[channel].baseline >= 0 ? _channel[channel].baseline >> PARTICLE_FRACTION : 0); }
+  uint32_t getNoise(uint8_t channel) const { return (channel < 3 ? _channel[channel].noise >> PARTICLE_FRACTION : 0); }
+  uint32_t getCount(uint8_t channel) const { return (channel < 3 ? _channel[channel].count : 0); } //Events since reset()
+  bool inEvent(uint8_t channel) const { return (channel < 3 && _channel[channel].state == PARTICLE_EVENT); }
+  uint32_t getSampleCount(void) const { return (_sampleCount); }
+  bool settling(void) const { return (_sampleCount < _settleUntil); } //Baseline still loading, nothing is detected
+
+  uint8_t eventsAvailable(void) const { return ((_logHead - _logTail) & (PARTICLE_LOG_SIZE - 1)); }
+  bool nextEvent(ParticleEvent &event); //Oldest unread event, false if none
+  uint16_t eventsDropped(void) const { return (_dropped); } //Events lost because the log was full
+
+ private:
+  static const uint8_t PARTICLE_FRACTION = 12; //Fractional bits of baseline and noise
+
+  //Channel states
+  static const uint8_t PARTICLE_IDLE = 0;
+  static const uint8_t PARTICLE_RISING = 1; //Over threshold, not yet debounced
+  static const uint8_t PARTICLE_EVENT = 2;
+
+  struct Channel
+  {
+    int32_t baseline; //PARTICLE_FRACTION fractional bits
+    int32_t noise; //Mean absolute deviation, PARTICLE_FRACTION fractional bits
+    uint8_t state;
+    uint8_t run; //Samples in a row over (rising) or under (event) threshold
+    uint32_t start;
+    uint32_t peak;
+    uint32_t count;
+  };
+
+  Channel _channel[3];
+  uint8_t _channels;
+
+  uint8_t _factor;
+  uint32_t _minimum;
+  uint8_t _debounceOn;
+  uint8_t _debounceOff;
+  uint16_t _maxDuration;
+  uint8_t _baselineShift;
+  uint8_t _noiseShift;
+
+  uint32_t _sampleCount;
+  uint32_t _settleUntil;
+
+  ParticleEvent _log[PARTICLE_LOG_SIZE];
+  uint8_t _logHead;
+  uint8_t _logTail;
+  uint16_t _dropped;
+
+  static void samplesReceived(const SampleSpan &samples, void *context);
+  void processChannel(uint8_t channel, const sense_sample_t *row, uint8_t first, uint8_t mask, uint8_t count);
+  void step(uint8_t channel, uint32_t sample, uint32_t index);
+  void logEvent(uint8_t channel, uint32_t start, uint16_t duration, uint32_t peak);
+};
@@ -0,0 +1,93 @@
+/*
+ Shared DC/AC Preprocessing Stage
+ SparkFun Electronics
+
+ See ppgChannel.h
+*/
+
+#include "ppgChannel.h"
+
+PPGChannel::PPGChannel(uint16_t sampleRate)
+{
+  _sampleRate = sampleRate > 0 ? sampleRate : 1;
+  reset();
+}
+
+void PPGChannel::reset(void)
+{
+  _sample = 0;
+  _dc = -1; //Loaded from the first sample
+  _ac = 0;
+
+  _avgReg = 0;
+  for (uint8_t x = 0 ; x < 32 ; x++) _cbuf[x] = 0;
+  _offset = 0;
+  _filteredAC = 0;
+
+  _acMax = 0;
+  _acMin = 0;
+  _acAmplitude = 0;
+  _sinceCrossing = 0;
+  _armed = false;
+  _cycleEnded = false;
+  _perfusionIndex = 0;
+
+  _windowSum = 0;
+}
+
+void PPGChannel::update(uint32_t sample)
+{
+  sample &= 0x3FFFF; //Readings are 18 bits
+  _sample = sample;
+  _windowSum += sample;
+
+  //Full range DC, same time constant as averageDCEstimator()
+  if (_dc < 0) _dc = (int32_t)sample << 8;
+  _dc += (((int32_t)sample << 8) - _dc) >> 4;
+  _ac = (int32_t)sample - (_dc >> 8);
+
+  //The beat detector's own DC and FIR, kept bit for bit so results match checkForBeat(detector, sample)
+  int16_t dc16 = averageDCEstimator(&_avgReg, sample);
+  _filteredAC = lowPassFIRFilter(_cbuf, &_offset, sample - dc16);
+
+  //Cycle amplitude, rising zero crossings with hysteresis as in SignalQuality
+  if (_ac > _acMax) _acMax = _ac;
+  if (_ac < _acMin) _acMin = _ac;
+
+  int32_t band = _acAmplitude >> 3;
+  if (band < 4) band = 4;
+  if (_ac < -band) _armed = true;
+
+  if (_sinceCrossing < 0xFFFF) _sinceCrossing++;
+
+  _cycleEnded = false;
+  if (_armed == true && _ac >= 0)
+  {
+    _armed = false;
+    _cycleEnded = true;
+    _acAmplitude = _acMax - _acMin;
+    _acMax = 0;
+    _acMin = 0;
+    _sinceCrossing = 0;
+  }
+  else if (_sinceCrossing > (uint32_t)_sampleRate * 2)
+  {
+    _acAmplitude = _acMax - _acMin; //No crossing for longer than 30bpm allows, report what we have
+  }
+  else return; //Amplitude unchanged, so is the perfusion index
+
+  //Divide once per cycle rather than every sample
+  int32_t dc = _dc >> 8;
+  uint32_t pi = (dc > 0) ? (uint32_t)_acAmplitude * 10000UL / (uint32_t)dc : 0;
+  _perfusionIndex = pi > 0xFFFF ? 0xFFFF : pi;
+}
+
+void PPGChannel::retire(uint32_t sample)
+{
+  _windowSum -= sample & 0x3FFFF;
+}
+
+bool checkForBeat(BeatDetector &detector, const PPGChannel &channel)
+{
+  return (checkForBeatAC(detector, channel.getFilteredAC()));
+}
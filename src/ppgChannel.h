@@ -0,0 +1,97 @@
+/*
+ Shared DC/AC Preprocessing Stage
+ SparkFun Electronics
+
+ Each consumer of a PPG channel used to do its own DC removal: checkForBeat()
+ runs averageDCEstimator() and the FIR, SignalQuality runs its own DC IIR and
+ the SpO2 calculation sums the whole window again for the IR mean. PPGChannel
+ does that work once per sample and the consumers read the result:
+
+  - checkForBeat(detector, channel) uses the filtered AC (no second DC/FIR)
+  - SignalQuality::update(channel) uses the DC, AC and cycle amplitude
+  - maxim_heart_rate_and_oxygen_saturation(..., channel) uses the running window mean
+
+ The filtered AC is fed from averageDCEstimator() as checkForBeat() does, not from
+ the full range DC, so checkForBeat(detector, channel) finds exactly the beats
+ checkForBeat(detector, sample) would.
+
+ Use one PPGChannel per LED (usually IR and red) and call update() once with every
+ sample. If the channel also feeds an SpO2 window call retire() with each sample
+ as it is dropped from the window so getWindowMean() stays in step with the buffer.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "heartRate.h"
+#include "spo2_algorithm.h"
+
+class PPGChannel {
+ public:
+  PPGChannel(uint16_t sampleRate = 25);
+
+  void reset(void);
+  void update(uint32_t sample); //Call with every sample of this channel
+  void retire(uint32_t sample); //Call with every sample removed from the SpO2 window
+
+  uint32_t getSample(void) const { return (_sample); }
+  int32_t getDC(void) const { return (_dc < 0 ? 0 : _dc >> 8); } //18-bit DC level
+  int32_t getAC(void) const { return (_ac); } //Sample less DC
+  int16_t getFilteredAC(void) const { return (_filteredAC); } //AC through the checkForBeat() low pass FIR
+  int32_t getACAmplitude(void) const { return (_acAmplitude); } //Peak to peak of the last cycle
+  bool cycleEnded(void) const { return (_cycleEnded); } //True on the sample that finished a cycle
+  uint16_t getPerfusionIndex(void) const { return (_perfusionIndex); } //AC/DC in 0.01% units, updated once per cycle
+  uint32_t getWindowMean(int32_t length) const { return (length > 0 ? _windowSum / length : 0); }
+
+ private:
+  uint16_t _sampleRate;
+  uint32_t _sample;
+
+  int32_t _dc; //DC estimate, 8 fractional bits
+  int32_t _ac;
+
+  //Filter state in the form checkForBeat() keeps it
+  int32_t _avgReg;
+  int16_t _cbuf[32];
+  uint8_t _offset;
+  int16_t _filteredAC;
+
+  //Cycle tracking for the amplitude and perfusion index
+  int32_t _acMax;
+  int32_t _acMin;
+  int32_t _acAmplitude;
+  uint16_t _sinceCrossing;
+  bool _armed; //AC has gone below the hysteresis band since the last up crossing
+  bool _cycleEnded;
+  uint16_t _perfusionIndex;
+
+  uint32_t _windowSum; //Sum of the samples in the SpO2 window, windows up to 16000 samples
+};
+
+//Beat detection on the channel's already filtered AC
+bool checkForBeat(BeatDetector &detector, const PPGChannel &channel);
+
+//SpO2/HR using the IR mean the channel has kept rather than summing the window again
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+void maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid, const PPGChannel &irChannel, maxim_spo2_workspace<SIZE> *p_workspace)
+{
+  //The channel sums full 18-bit samples, a uint16_t buffer holds them cut to 16 bits and the means wouldn't match
+  static_assert(sizeof(SAMPLE) >= 4, "The PPGChannel window mean needs a 32-bit sample buffer, use the overload without a channel");
+  maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid,
+                pn_heart_rate, pch_hr_valid, p_workspace, irChannel.getWindowMean(n_ir_buffer_length));
+}
+
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+void maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid, const PPGChannel &irChannel)
+{
+  static maxim_spo2_workspace<SIZE> workspace;
+  maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid,
+                pn_heart_rate, pch_hr_valid, irChannel, &workspace);
+}
@@ -0,0 +1,312 @@
+/*
+ Two Stage Acquisition/Processing Pipeline for Linux hosts
+ SparkFun Electronics
+
+ Run against a simulated or bridged sensor, a single loop that reads the FIFO
+ and then runs the SpO2 calculation falls behind while the calculation runs
+ and the FIFO overflows. PPGPipeline gives each job its own thread:
+
+  - Acquisition drains the FIFO into a sample block
+  - Processing runs the beat detector and SpO2 on the block before
+
+ There are two blocks, allocated up front. Blocks are handed between the
+ threads by index so nothing is copied or allocated once running. If
+ processing still has the other block when acquisition fills one, the filled
+ block is reused and counted in droppedBlocks rather than stalling the FIFO.
+
+ Each stage keeps its own busy time and block count so the latency and
+ throughput of acquisition and processing can be measured separately.
+
+ The driver only keeps STORAGE_SIZE - 1 unread samples, so set the poll
+ interval short enough that fewer than that arrive between polls.
+
+ Only built on Linux hosts.
+*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#include "MAX30105.h"
+#include "heartRate.h"
+#include "spo2_algorithm.h"
+#include "ppgChannel.h"
+#include "batchAnalysis.h"
+
+//A block of samples from the FIFO
+struct PPGBlock
+{
+  std::vector<uint32_t> red;
+  std::vector<uint32_t> ir;
+  uint32_t count; //Samples used
+  uint64_t firstSample; //Index of red[0] since start()
+  std::chrono::steady_clock::time_point filled; //When acquisition handed it over
+};
+
+struct PPGStageStats
+{
+  uint64_t blocks;
+  uint64_t samples;
+  double busySeconds; //Time spent working rather than waiting
+  double maxBlockSeconds; //Longest time on one block
+};
+
+struct PPGPipelineStats
+{
+  PPGStageStats acquisition;
+  PPGStageStats processing;
+  uint64_t droppedBlocks; //Filled while processing still held the other block
+  double maxQueueSeconds; //Longest a full block waited for processing
+};
+
+//FREQ and SIZE select the SpO2 window as in maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>()
+template <int32_t FREQ = FreqS, int32_t SIZE = BUFFER_SIZE>
+class PPGPipeline
+{
+  static_assert(SIZE >= FREQ, "The SpO2 window must hold at least one second");
+
+ public:
+  PPGPipeline(MAX30105 &sensor, uint32_t blockSamples = FREQ) : _sensor(sensor), _ir(FREQ)
+  {
+    for (uint8_t x = 0 ; x < 2 ; x++)
+    {
+      _blocks[x].red.resize(blockSamples > 0 ? blockSamples : 1);
+      _blocks[x].ir.resize(blockSamples > 0 ? blockSamples : 1);
+      _blocks[x].count = 0;
+      _blocks[x].firstSample = 0;
+    }
+    _pollInterval = std::chrono::microseconds(2000);
+    _running = false;
+  }
+
+  ~PPGPipeline() { stop(); }
+
+  //Called from the processing thread
+  void onBeat(const std::function<void(uint64_t sample)> &callback) { _onBeat = callback; }
+  void onSpO2(const std::function<void(const SpO2Reading &reading)> &callback) { _onSpO2 = callback; }
+
+  //How long acquisition sleeps when the FIFO is empty
+  void setPollInterval(std::chrono::microseconds interval) { _pollInterval = interval; }
+
+  void start(void)
+  {
+    if (_running) return;
+
+    _stopping = false;
+    _full = -1;
+    _processing = -1;
+    _samples = 0;
+    _windowFill = 0;
+    _nextSample = 0;
+    _ir.reset();
+    _detector = BeatDetector();
+    memset(&_stats, 0, sizeof(_stats));
+
+    //A block part filled before stop() belongs to the last run
+    for (uint8_t x = 0 ; x < 2 ; x++)
+    {
+      _blocks[x].count = 0;
+      _blocks[x].firstSample = 0;
+    }
+
+    _running = true;
+    _processThread = std::thread(&PPGPipeline::processingLoop, this);
+    _acquireThread = std::thread(&PPGPipeline::acquisitionLoop, this);
+  }
+
+  //Samples in a part filled block are not processed
+  void stop(void)
+  {
+    if (!_running) return;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _stopping = true;
+    }
+    _ready.notify_all();
+    _acquireThread.join();
+    _processThread.join();
+    _running = false;
+  }
+
+  bool running(void) const { return (_running); }
+
+  PPGPipelineStats stats(void)
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    return (_stats);
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  static double seconds(Clock::duration d) { return (std::chrono::duration<double>(d).count()); }
+
+  static void account(PPGStageStats &stage, uint32_t samples, Clock::duration busy)
+  {
+    stage.blocks++;
+    stage.samples += samples;
+    stage.busySeconds += seconds(busy);
+    if (seconds(busy) > stage.maxBlockSeconds) stage.maxBlockSeconds = seconds(busy);
+  }
+
+  void acquisitionLoop(void)
+  {
+    int filling = 0;
+    Clock::duration busy = Clock::duration::zero();
+
+    while (true)
+    {
+      {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_stopping) return;
+      }
+
+      Clock::time_point begin = Clock::now();
+      bool gotData = (_sensor.check() > 0);
+
+      //Take what check() read, the driver only has room for a few samples. The rest waits in
+      //the FIFO for the next pass, which comes straight away as gotData is set.
+      while (_sensor.available())
+      {
+        PPGBlock &block = _blocks[filling];
+        if (block.count == 0) block.firstSample = _samples;
+        block.red[block.count] = _sensor.getFIFORed();
+        block.ir[block.count] = _sensor.getFIFOIR();
+        _sensor.nextSample();
+        block.count++;
+        _samples++;
+
+        if (block.count < block.red.size()) continue;
+
+        //Block full, hand it over if processing is done with the other one
+        block.filled = Clock::now();
+        busy += block.filled - begin;
+        begin = block.filled;
+
+        std::lock_guard<std::mutex> guard(_lock);
+        account(_stats.acquisition, block.count, busy);
+        busy = Clock::duration::zero();
+
+        int other = 1 - filling;
+        if (_full == -1 && _processing != other)
+        {
+          _full = filling;
+          filling = other;
+          _blocks[filling].count = 0;
+          _ready.notify_one();
+        }
+        else
+        {
+          _stats.droppedBlocks++;
+          block.count = 0; //Reuse it, processing sees the gap from firstSample
+        }
+      }
+
+      busy += Clock::now() - begin;
+      if (!gotData) std::this_thread::sleep_for(_pollInterval);
+    }
+  }
+
+  void processingLoop(void)
+  {
+    while (true)
+    {
+      int index;
+      {
+        std::unique_lock<std::mutex> guard(_lock);
+        _ready.wait(guard, [this] { return (_stopping || _full != -1); });
+        if (_full == -1) return; //Stopping
+
+        index = _full;
+        _full = -1;
+        _processing = index;
+
+        double queued = seconds(Clock::now() - _blocks[index].filled);
+        if (queued > _stats.maxQueueSeconds) _stats.maxQueueSeconds = queued;
+      }
+
+      Clock::time_point begin = Clock::now();
+      process(_blocks[index]);
+      Clock::duration busy = Clock::now() - begin;
+
+      std::lock_guard<std::mutex> guard(_lock);
+      account(_stats.processing, _blocks[index].count, busy);
+      _processing = -1;
+    }
+  }
+
+  //Beat detection on every sample, SpO2 on a SIZE window once a second as in Example8_SPO2
+  void process(const PPGBlock &block)
+  {
+    //After a dropped block the samples don't follow on, start the filters and the window again
+    if (block.firstSample != _nextSample)
+    {
+      _ir.reset();
+      _detector = BeatDetector();
+      _windowFill = 0;
+    }
+    _nextSample = block.firstSample + block.count;
+
+    for (uint32_t x = 0 ; x < block.count ; x++)
+    {
+      uint64_t sample = block.firstSample + x;
+
+      _ir.update(block.ir[x]);
+      if (checkForBeat(_detector, _ir) == true && _onBeat) _onBeat(sample);
+
+      _irWindow[_windowFill] = block.ir[x];
+      _redWindow[_windowFill] = block.red[x];
+      if (++_windowFill < SIZE) continue;
+
+      SpO2Reading reading;
+      reading.sample = (uint32_t)(sample + 1 - SIZE);
+      maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(_irWindow, SIZE, _redWindow, &reading.spo2, &reading.spo2Valid,
+          &reading.heartRate, &reading.heartRateValid, _ir, &_workspace);
+      if (_onSpO2) _onSpO2(reading);
+
+      //Drop the oldest second
+      for (int32_t y = 0 ; y < FREQ ; y++) _ir.retire(_irWindow[y]);
+      memmove(_irWindow, _irWindow + FREQ, (SIZE - FREQ) * sizeof(uint32_t));
+      memmove(_redWindow, _redWindow + FREQ, (SIZE - FREQ) * sizeof(uint32_t));
+      _windowFill = SIZE - FREQ;
+    }
+  }
+
+  MAX30105 &_sensor;
+  PPGBlock _blocks[2];
+  std::chrono::microseconds _pollInterval;
+
+  std::thread _acquireThread;
+  std::thread _processThread;
+  std::mutex _lock; //Guards the fields below and _stats
+  std::condition_variable _ready;
+  bool _stopping;
+  int _full; //Block waiting for processing, -1 if none
+  int _processing; //Block being processed, -1 if none
+  PPGPipelineStats _stats;
+  bool _running;
+
+  uint64_t _samples; //Acquisition thread only
+
+  //Processing thread only
+  PPGChannel _ir;
+  BeatDetector _detector;
+  uint32_t _irWindow[SIZE];
+  uint32_t _redWindow[SIZE];
+  int32_t _windowFill;
+  uint64_t _nextSample; //firstSample the next block has if none was dropped
+  maxim_spo2_workspace<SIZE> _workspace;
+  std::function<void(uint64_t)> _onBeat;
+  std::function<void(const SpO2Reading &)> _onSpO2;
+};
+
+#endif //__linux__
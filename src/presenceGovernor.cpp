@@ -0,0 +1,142 @@
+/*
+ Proximity Gated Low Power Acquisition
+ SparkFun Electronics
+
+ See presenceGovernor.h
+*/
+
+#include "presenceGovernor.h"
+
+static const uint8_t GOVERNOR_INT_PROX = 0x10; //PROX_INT bit of INT1
+
+PresenceGovernor::PresenceGovernor(void)
+{
+  _sensor = NULL;
+  _method = GOVERNOR_PROXIMITY;
+  _state = GOVERNOR_ACTIVE;
+  _presentLevel = 0x20UL << 10;
+  _lostLevel = _presentLevel / 2;
+  _lostSamples = 25;
+  _lostCount = 0;
+  _sleepMillis = 1000;
+  _lookMillis = 30;
+  _mark = 0;
+  _changed = false;
+}
+
+//Call after setup() so the acquisition settings are already in place
+void PresenceGovernor::begin(MAX30105 &sensor, uint8_t method, uint8_t threshold, uint8_t pilotAmplitude)
+{
+  _sensor = &sensor;
+  _method = method;
+  _presentLevel = (uint32_t)threshold << 10;
+  _lostLevel = _presentLevel / 2;
+
+  if (_method == GOVERNOR_PROXIMITY)
+  {
+    _sensor->setPulseAmplitudeProximity(pilotAmplitude);
+    _sensor->setPROXINTTHRESH(threshold);
+    _sensor->enablePROXINT();
+  }
+  else
+    _sensor->disablePROXINT();
+
+  deactivate();
+  _changed = false;
+}
+
+void PresenceGovernor::setLostLevel(uint32_t level, uint16_t samples)
+{
+  _lostLevel = level;
+  _lostSamples = samples > 0 ? samples : 1;
+}
+
+void PresenceGovernor::setDutyCycle(uint16_t sleepMillis, uint16_t lookMillis)
+{
+  _sleepMillis = sleepMillis;
+  _lookMillis = lookMillis;
+}
+
+uint8_t PresenceGovernor::update(void)
+{
+  if (_sensor == NULL) return (_state);
+
+  if (_state == GOVERNOR_WAITING)
+  {
+    if (_sensor->getINT1() & GOVERNOR_INT_PROX) activate(); //Part has already switched to full acquisition
+  }
+  else if (_state == GOVERNOR_SLEEPING)
+  {
+    if (millis() - _mark >= _sleepMillis)
+    {
+      _sensor->wakeUp();
+      _sensor->clearFIFO();
+      _state = GOVERNOR_LOOKING;
+      _mark = millis();
+    }
+  }
+  else if (_state == GOVERNOR_LOOKING)
+  {
+    if (millis() - _mark >= _lookMillis)
+    {
+      uint32_t ir = _sensor->getIR(); //Newest sample taken while awake, 0 if there was none
+
+      if (ir >= _presentLevel) activate();
+      else
+      {
+        _sensor->shutDown();
+        _state = GOVERNOR_SLEEPING;
+        _mark = millis();
+      }
+    }
+  }
+
+  return (_state);
+}
+
+void PresenceGovernor::sample(uint32_t ir)
+{
+  if (_state != GOVERNOR_ACTIVE) return;
+
+  if (ir >= _lostLevel)
+  {
+    _lostCount = 0;
+    return;
+  }
+
+  if (++_lostCount >= _lostSamples) deactivate();
+}
+
+bool PresenceGovernor::presenceChanged(void)
+{
+  bool changed = _changed;
+  _changed = false;
+  return (changed);
+}
+
+void PresenceGovernor::activate(void)
+{
+  _sensor->clearFIFO(); //Don't hand over samples from before the finger arrived
+  _state = GOVERNOR_ACTIVE;
+  _lostCount = 0;
+  _mark = millis();
+  _changed = true;
+}
+
+void PresenceGovernor::deactivate(void)
+{
+  if (_method == GOVERNOR_PROXIMITY)
+  {
+    _sensor->getINT1(); //Clear any stale PROX_INT
+    _sensor->reenterProximityMode();
+    _state = GOVERNOR_WAITING;
+  }
+  else
+  {
+    _sensor->shutDown();
+    _state = GOVERNOR_SLEEPING;
+  }
+
+  _mark = millis();
+  _changed = true;
+}
@@ -0,0 +1,74 @@
+/*
+ Proximity Gated Low Power Acquisition
+ SparkFun Electronics
+
+ Running the LEDs at full SpO2/HR settings while nobody is touching the sensor
+ wastes most of a battery node's charge. PresenceGovernor keeps the sensor in a
+ low current state until something is in front of it, hands over to full
+ acquisition, and goes back to waiting when the finger is removed.
+
+ Two ways of waiting:
+  - GOVERNOR_PROXIMITY: the part's own proximity mode. Only the pilot LED pulses
+    (setPulseAmplitudeProximity()) until the IR count crosses the PROX_INT threshold,
+    then the part changes to the programmed mode by itself and raises PROX_INT.
+  - GOVERNOR_DUTY_CYCLE: shutDown() most of the time, waking for a short look.
+    For setups where proximity mode can't be used.
+
+ Call update() from loop(). If the INT pin is wired it only needs to be called
+ when the pin is low while waiting. While active, feed every IR sample to sample()
+ so loss of contact is noticed.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "MAX30105.h"
+
+//Ways of waiting
+#define GOVERNOR_PROXIMITY    0
+#define GOVERNOR_DUTY_CYCLE   1
+
+//States
+#define GOVERNOR_WAITING      0 //Proximity mode, pilot LED only
+#define GOVERNOR_SLEEPING     1 //Shut down between looks
+#define GOVERNOR_LOOKING      2 //Briefly awake to check for presence
+#define GOVERNOR_ACTIVE       3 //Full acquisition, read samples as normal
+
+class PresenceGovernor {
+ public:
+  PresenceGovernor(void);
+
+  //threshold is the 8 MSBs of the IR count (count >> 10) that means something is there
+  void begin(MAX30105 &sensor, uint8_t method = GOVERNOR_PROXIMITY, uint8_t threshold = 0x20, uint8_t pilotAmplitude = 0x0A);
+
+  uint8_t update(void); //Returns the state
+  void sample(uint32_t ir); //Call with every IR sample while active
+
+  uint8_t getState(void) const { return (_state); }
+  bool active(void) const { return (_state == GOVERNOR_ACTIVE); }
+  bool presenceChanged(void); //True once after each change to or from active. Restart analysis then.
+
+  void setLostLevel(uint32_t level, uint16_t samples); //IR below level for this many samples ends acquisition. Default half the threshold, 25 samples.
+  void setDutyCycle(uint16_t sleepMillis, uint16_t lookMillis); //Default 1000ms asleep, 30ms awake
+
+ private:
+  MAX30105 *_sensor;
+  uint8_t _method;
+  uint8_t _state;
+  uint32_t _presentLevel;
+  uint32_t _lostLevel;
+  uint16_t _lostSamples;
+  uint16_t _lostCount;
+  uint16_t _sleepMillis;
+  uint16_t _lookMillis;
+  uint32_t _mark; //millis() at the last state change
+  bool _changed;
+
+  void activate(void);
+  void deactivate(void);
+};
@@ -0,0 +1,141 @@
+/*
+ Push Style Heart Rate and SpO2
+ SparkFun Electronics
+
+ Instead of polling available(), reading each sample with getFIFOIR(), calling
+ nextSample() and feeding checkForBeat() by hand, attach a PulseMonitor to the
+ sensor and register callbacks:
+
+  - MAX30105::onSamples() is called by check() once per block of new samples
+  - PulseMonitor::onBeat() is called with the interval since the last beat
+  - PulseMonitor::onSpO2() is called every second once a SIZE sample window is full
+
+ Callbacks are plain function pointers with a context pointer. Nothing is
+ allocated and there are no virtual calls. loop() then only has to call check().
+
+ Every callback, and the beat detection and SpO2 work behind them, runs inside
+ check(). Call check() from loop(), not from an interrupt handler: the SpO2
+ calculation takes far too long for an ISR, and Serial may block there.
+
+ FREQ must match the rate samples arrive at (sampleRate / sampleAverage).
+ On AVR use PackedSample for SAMPLE to make the SpO2 window a quarter smaller
+ without losing bits, or uint16_t to halve it as in Example8_SPO2. With either
+ the SpO2 code sums the IR window itself instead of using the PPGChannel's mean.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "MAX30105.h"
+#include "heartRate.h"
+#include "spo2_algorithm.h"
+#include "ppgChannel.h"
+#include "packedSamples.h"
+
+typedef void (*BeatCallback)(uint16_t ibiMillis, void *context); //ibiMillis is 0 for the first beat
+typedef void (*SpO2Callback)(const SpO2Reading &reading, void *context);
+
+template <int32_t FREQ = FreqS, int32_t SIZE = BUFFER_SIZE, typename SAMPLE = uint32_t>
+class PulseMonitor {
+ public:
+  PulseMonitor(void) : _ir(FREQ)
+  {
+    _beatCallback = NULL;
+    _beatContext = NULL;
+    _spo2Callback = NULL;
+    _spo2Context = NULL;
+    reset();
+  }
+
+  //Receive samples from the sensor's check()
+  void begin(MAX30105 &sensor) { sensor.onSamples(samplesReceived, this); }
+
+  void onBeat(BeatCallback callback, void *context = NULL) { _beatContext = context; _beatCallback = callback; }
+  void onSpO2(SpO2Callback callback, void *context = NULL) { _spo2Context = context; _spo2Callback = callback; } //SpO2 only runs with a callback
+
+  void reset(void)
+  {
+    _ir.reset();
+    _detector = BeatDetector();
+    _samples = 0;
+    _lastBeat = 0;
+    _windowFill = 0;
+  }
+
+  //Can also be called directly with samples from elsewhere
+  void process(const SampleSpan &samples)
+  {
+    for (uint8_t x = 0 ; x < samples.count ; x++)
+    {
+      uint32_t ir = samples.IR(x);
+      _samples++;
+
+      _ir.update(ir);
+      if (checkForBeat(_detector, _ir) == true && _beatCallback != NULL)
+      {
+        uint32_t interval = (_lastBeat == 0) ? 0 : (_samples - _lastBeat) * 1000UL / FREQ;
+        _lastBeat = _samples;
+        _beatCallback(interval > 0xFFFF ? 0xFFFF : interval, _beatContext);
+      }
+
+      if (_spo2Callback == NULL) continue;
+
+      _irWindow[_windowFill] = ir;
+      _redWindow[_windowFill] = samples.red(x);
+      if (++_windowFill < SIZE) continue;
+
+      SpO2Reading reading;
+      reading.sample = _samples - SIZE;
+      spo2(reading, WindowMean<(sizeof(SAMPLE) >= 4)>());
+      _spo2Callback(reading, _spo2Context);
+
+      //Drop the oldest second
+      for (int32_t y = 0 ; y < FREQ ; y++) _ir.retire(_irWindow[y]);
+      memmove(_irWindow, _irWindow + FREQ, (SIZE - FREQ) * sizeof(SAMPLE));
+      memmove(_redWindow, _redWindow + FREQ, (SIZE - FREQ) * sizeof(SAMPLE));
+      _windowFill = SIZE - FREQ;
+    }
+  }
+
+ private:
+  static void samplesReceived(const SampleSpan &samples, void *context)
+  {
+    static_cast<PulseMonitor *>(context)->process(samples);
+  }
+
+  //Picked at compile time so only the overload SAMPLE can use is built. The channel's mean is
+  //the window's only when the window holds 32-bit samples (see ppgChannel.h), otherwise the
+  //SpO2 code sums the window itself.
+  template <bool CHANNEL_MEAN> struct WindowMean {};
+
+  void spo2(SpO2Reading &reading, WindowMean<true>)
+  {
+    maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(_irWindow, SIZE, _redWindow, &reading.spo2, &reading.spo2Valid,
+        &reading.heartRate, &reading.heartRateValid, _ir);
+  }
+
+  void spo2(SpO2Reading &reading, WindowMean<false>)
+  {
+    maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(_irWindow, SIZE, _redWindow, &reading.spo2, &reading.spo2Valid,
+        &reading.heartRate, &reading.heartRateValid);
+  }
+
+  PPGChannel _ir;
+  BeatDetector _detector;
+  uint32_t _samples; //Samples processed
+  uint32_t _lastBeat; //Value of _samples at the last beat
+
+  SAMPLE _irWindow[SIZE];
+  SAMPLE _redWindow[SIZE];
+  int32_t _windowFill;
+
+  BeatCallback _beatCallback;
+  void *_beatContext;
+  SpO2Callback _spo2Callback;
+  void *_spo2Context;
+};
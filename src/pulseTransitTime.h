@@ -0,0 +1,320 @@
+/*
+ Pulse Transit Time between sensors
+ SparkFun Electronics
+
+ With sensors at two body sites, say a finger and a toe, the pulse reaches the
+ further one later. That delay, the pulse transit time, gets shorter as blood
+ pressure rises, so it can be followed as a blood pressure trend.
+
+ Each sensor samples on its own clock and is read whenever loop() gets to it, so
+ samples are added with the micros() time they were taken. Every stream is
+ resampled onto one grid of FREQ samples a second, which lines them up to within
+ the timestamps' accuracy. The delay of each stream behind stream 0 comes from the
+ cross-correlation of their slopes (first differences): slopes have no DC or
+ baseline wander, and are largest on the pulse's upstroke, where arrival is timed.
+
+ The correlation is kept up to date incrementally. Each grid sample adds one
+ product per lag for each stream after the first, and older products fade away
+ with a time constant of 2^DECAY grid samples, so no window of samples is stored.
+ On every beat of stream 0 the peak lag is found and a parabola through it and its
+ neighbours gives the delay to a fraction of a grid period.
+
+ Lags of up to MAXLAG grid samples either way are searched, 160ms at the defaults.
+ Memory is 2 * HISTORY bytes a stream plus 4 * (2 * MAXLAG + 1) for each stream
+ after the first, about 500 bytes for two streams at the defaults.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include <math.h>
+
+#include "MAX30105.h"
+
+//Channel of a SampleSpan to follow
+#define PTT_RED               0
+#define PTT_IR                1
+#define PTT_GREEN             2
+
+//Smallest power of two at least needed
+constexpr uint16_t ptt_power_of_two(uint16_t needed, uint16_t size = 1)
+{ return (size >= needed ? size : ptt_power_of_two(needed, size * 2)); }
+constexpr uint8_t ptt_log2(uint32_t x) { return (x <= 1 ? 0 : 1 + ptt_log2(x / 2)); }
+
+template <uint16_t FREQ = 100, uint8_t MAXLAG = 16, uint8_t STREAMS = 2, uint8_t DECAY = 7>
+class PulseTransitTime {
+ public:
+  static const uint16_t LAGS = 2 * MAXLAG + 1;
+  static const uint16_t HISTORY = ptt_power_of_two(LAGS + 17); //Slopes kept per stream: the lags, plus room for streams to be out of step
+  static const uint16_t SKEW = HISTORY - LAGS - 1; //Grid samples a stream can trail the newest before it is held at its last value
+  static const uint32_t PERIOD = 1000000UL / FREQ; //Grid period in us
+  static const uint8_t PEAK_DECAY = ptt_log2(FREQ) + 1; //About 1.3 seconds, for the beat detector's slope peak
+
+  static_assert(STREAMS >= 2, "Need a reference stream and at least one more");
+  static_assert(MAXLAG >= 2 && MAXLAG <= 100, "MAXLAG must be 2 to 100 grid samples");
+  static_assert(DECAY <= 8, "Correlation sums overflow past a DECAY of 8");
+  static_assert(FREQ >= 10 && FREQ <= 3200, "FREQ must be 10 to 3200 samples a second");
+  static_assert((uint32_t)HISTORY * PERIOD < (1UL << 24), "Interpolation across HISTORY grid samples would overflow");
+
+  PulseTransitTime(void) { reset(); }
+
+  void reset(void)
+  {
+    memset(_streams, 0, sizeof(_streams));
+    memset(_corr, 0, sizeof(_corr));
+    memset(_energy, 0, sizeof(_energy));
+    memset(_delay, 0, sizeof(_delay));
+    memset(_confidence, 0, sizeof(_confidence));
+    _epochSet = false;
+    _epoch = 0;
+    _processed = 0;
+    _slopePeak = 0;
+    _rising = false;
+    _sinceBeat = 0;
+    _available = false;
+    _beats = 0;
+  }
+
+  //Add one sample of a stream, taken at timeMicros on the micros() clock. A stream's times must go forwards.
+  //Samples a sensor read in one burst were taken a sample period apart, not at the time of the read.
+  void add(uint8_t stream, int32_t sample, uint32_t timeMicros)
+  {
+    if (stream >= STREAMS) return;
+    Stream &s = _streams[stream];
+
+    if (_epochSet == false)
+    {
+      _epoch = timeMicros;
+      _epochSet = true;
+    }
+
+    if (s.started == false)
+    {
+      //The grid before a stream's first sample takes its value
+      s.started = true;
+      s.gridValue = sample;
+      s.nextGrid = _epoch + s.count * PERIOD;
+      holdTo(s, gridIndexAfter(s, timeMicros));
+    }
+    else
+    {
+      int32_t gap = (int32_t)(timeMicros - s.lastTime);
+      if (gap <= 0) return;
+
+      if ((uint32_t)gap > (uint32_t)HISTORY * PERIOD)
+      {
+        //Too long to interpolate across, hold the last value and start again from this sample
+        holdTo(s, gridIndexAfter(s, timeMicros));
+        s.gridValue = sample;
+      }
+      else
+      {
+        //Linear interpolation at each grid time up to this sample, 8 fractional bits
+        int32_t change = sample - s.lastValue;
+        if (change > 0x3FFFFF) change = 0x3FFFFF;
+        if (change < -0x3FFFFF) change = -0x3FFFFF;
+        while ((int32_t)(timeMicros - s.nextGrid) >= 0)
+        {
+          int32_t fraction = (int32_t)(((s.nextGrid - s.lastTime) << 8) / (uint32_t)gap);
+          push(s, s.lastValue + ((change * fraction) >> 8));
+        }
+      }
+    }
+
+    s.lastValue = sample;
+    s.lastTime = timeMicros;
+
+    advance();
+  }
+
+  //Add a block of samples handed to an onSamples() callback
+  //lastMicros is when the newest sample of the whole check() was taken, samples.checkMicros is close enough.
+  //periodMicros is the sensor's sample period after averaging, for example 10000 for 400sps averaged by 4.
+  //samples.later places each block of a long drain before the ones that follow it.
+  void add(uint8_t stream, const SampleSpan &samples, uint32_t lastMicros, uint32_t periodMicros, uint8_t channel = PTT_IR)
+  {
+    uint32_t blockMicros = lastMicros - (uint32_t)samples.later * periodMicros; //Newest of this block
+    for (uint8_t i = 0 ; i < samples.count ; i++)
+    {
+      uint32_t value = (channel == PTT_RED ? samples.red(i) : (channel == PTT_GREEN ? samples.green(i) : samples.IR(i)));
+      add(stream, (int32_t)value, blockMicros - (uint32_t)(samples.count - 1 - i) * periodMicros);
+    }
+  }
+
+  bool available(void) //True once after each beat of stream 0, when the delays have been worked out again
+  {
+    bool result = _available;
+    _available = false;
+    return (result);
+  }
+
+  //How much later the pulse reaches stream than stream 0, negative if earlier
+  int32_t getDelayMicros(uint8_t stream) const { return (stream < STREAMS ? _delay[stream] : 0); }
+  //How alike the two pulse shapes are at that delay, 0 to 100. 0 if the peak is at the end of the lag range.
+  uint8_t getConfidence(uint8_t stream) const { return (stream < STREAMS ? _confidence[stream] : 0); }
+  uint32_t getBeats(void) const { return (_beats); }
+
+ private:
+  struct Stream
+  {
+    int16_t slope[HISTORY]; //First differences on the grid, indexed by grid sample
+    int32_t lastValue; //Newest sample added and its time
+    uint32_t lastTime;
+    int32_t gridValue; //Value at the newest grid sample
+    uint32_t nextGrid; //Time of the next grid sample
+    uint32_t count; //Grid samples made
+    bool started;
+  };
+
+  Stream _streams[STREAMS];
+  int32_t _corr[STREAMS - 1][LAGS]; //Stream s against stream 0 shifted by lag - MAXLAG
+  int32_t _energy[STREAMS];
+
+  bool _epochSet;
+  uint32_t _epoch; //Time of grid sample 0
+  uint32_t _processed; //Grid samples every stream has made and the correlation has taken in
+
+  //Beat detection on stream 0
+  int32_t _slopePeak; //4 fractional bits
+  bool _rising;
+  uint16_t _sinceBeat;
+
+  int32_t _delay[STREAMS];
+  uint8_t _confidence[STREAMS];
+  bool _available;
+  uint32_t _beats;
+
+  //Number of grid samples at or before time
+  uint32_t gridIndexAfter(const Stream &s, uint32_t time) const
+  {
+    if ((int32_t)(time - s.nextGrid) < 0) return (s.count);
+    return (s.count + (time - s.nextGrid) / PERIOD + 1);
+  }
+
+  void push(Stream &s, int32_t value)
+  {
+    int32_t slope = value - s.gridValue;
+    if (slope > 2047) slope = 2047; //Keeps products in 22 bits
+    if (slope < -2047) slope = -2047;
+    s.slope[s.count & (HISTORY - 1)] = slope;
+    s.gridValue = value;
+    s.count++;
+    s.nextGrid += PERIOD;
+  }
+
+  //Hold a stream at its grid value until it has made count samples. Held samples have no slope.
+  void holdTo(Stream &s, uint32_t count)
+  {
+    int32_t missing = (int32_t)(count - s.count);
+    if (missing <= 0) return;
+
+    if (missing >= HISTORY)
+    {
+      memset(s.slope, 0, sizeof(s.slope));
+      s.count = count;
+      s.nextGrid += (uint32_t)missing * PERIOD;
+      return;
+    }
+    while (missing-- > 0) push(s, s.gridValue);
+  }
+
+  //Correlate every grid sample all the streams have reached
+  void advance(void)
+  {
+    uint32_t newest = _streams[0].count;
+    for (uint8_t x = 1 ; x < STREAMS ; x++)
+      if ((int32_t)(_streams[x].count - newest) > 0) newest = _streams[x].count;
+
+    //A stream that stops coming (unplugged, or not read) mustn't hold up the rest
+    uint32_t slowest = newest;
+    for (uint8_t x = 0 ; x < STREAMS ; x++)
+    {
+      if ((int32_t)(newest - _streams[x].count) > SKEW) holdTo(_streams[x], newest - SKEW);
+      if ((int32_t)(_streams[x].count - slowest) < 0) slowest = _streams[x].count;
+    }
+
+    //Stream 0's slopes back to MAXLAG before the centre lag must still be in its history
+    if ((int32_t)(newest - SKEW - 2 - _processed) > 0) _processed = newest - SKEW - 2;
+
+    while ((int32_t)(slowest - _processed) > 0)
+    {
+      if (_processed >= 2 * MAXLAG) correlate(_processed);
+      _processed++;
+    }
+  }
+
+  //Add grid sample n: stream s at n - MAXLAG against stream 0 from n - 2 * MAXLAG to n
+  void correlate(uint32_t n)
+  {
+    const uint16_t mask = HISTORY - 1;
+    const int16_t *reference = _streams[0].slope;
+    uint32_t centre = n - MAXLAG;
+
+    int32_t r = reference[centre & mask];
+    _energy[0] += r * r - (_energy[0] >> DECAY);
+
+    for (uint8_t x = 1 ; x < STREAMS ; x++)
+    {
+      int32_t slope = _streams[x].slope[centre & mask];
+      _energy[x] += slope * slope - (_energy[x] >> DECAY);
+
+      int32_t *corr = _corr[x - 1];
+      for (uint16_t lag = 0 ; lag < LAGS ; lag++)
+        corr[lag] += slope * reference[(n - lag) & mask] - (corr[lag] >> DECAY);
+    }
+
+    detectBeat(reference[n & mask]);
+  }
+
+  //A beat is stream 0's slope rising through half its recent peak
+  void detectBeat(int32_t slope)
+  {
+    _slopePeak -= _slopePeak >> PEAK_DECAY;
+    if (slope * 16 > _slopePeak) _slopePeak = slope * 16;
+    if (_sinceBeat < 0xFFFF) _sinceBeat++;
+
+    bool rising = (slope > 0 && slope * 32 > _slopePeak);
+    if (rising && _rising == false && _sinceBeat >= FREQ / 4) //At most 240bpm
+    {
+      _sinceBeat = 0;
+      estimate();
+    }
+    _rising = rising;
+  }
+
+  void estimate(void)
+  {
+    _beats++;
+    _available = true;
+
+    for (uint8_t x = 1 ; x < STREAMS ; x++)
+    {
+      const int32_t *corr = _corr[x - 1];
+      uint16_t peak = 0;
+      for (uint16_t lag = 1 ; lag < LAGS ; lag++)
+        if (corr[lag] > corr[peak]) peak = lag;
+
+      _confidence[x] = 0;
+      if (peak == 0 || peak == LAGS - 1 || corr[peak] <= 0)
+      {
+        _delay[x] = ((int32_t)peak - MAXLAG) * (int32_t)PERIOD; //Outside the range searched
+        continue;
+      }
+
+      float before = corr[peak - 1];
+      float centre = corr[peak];
+      float after = corr[peak + 1];
+      float curve = before - 2 * centre + after;
+      float offset = (curve < 0 ? 0.5f * (before - after) / curve : 0);
+      _delay[x] = lroundf(((int32_t)peak - MAXLAG + offset) * PERIOD);
+
+      float energy = sqrtf((float)_energy[0] * _energy[x]);
+      if (energy > 0) _confidence[x] = (uint8_t)(centre >= energy ? 100 : 100.0f * centre / energy + 0.5f);
+    }
+  }
+};
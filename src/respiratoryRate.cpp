@@ -0,0 +1,171 @@
+/*
+ Respiratory Rate from PPG
+ SparkFun Electronics
+
+ See respiratoryRate.h
+*/
+
+#include "respiratoryRate.h"
+
+RespiratoryRate::RespiratoryRate(uint16_t sampleRate)
+{
+  if (sampleRate == 0) sampleRate = 1;
+  _decimation = sampleRate / 4; //About 4 samples a second
+  if (_decimation == 0) _decimation = 1;
+  _rate = (uint32_t)sampleRate * 60 / _decimation;
+  _shortest = _rate / 42; //42 breaths per minute
+  _longest = _rate / 6; //6 breaths per minute
+
+  //Trend time constant of about 8 seconds
+  uint16_t trendSamples = _rate / 60 * 8;
+  _trendShift = 1;
+  while ((1U << (_trendShift + 1)) <= trendSamples && _trendShift < 12) _trendShift++;
+
+  reset();
+}
+
+void RespiratoryRate::reset(void)
+{
+  _dcSum = 0;
+  _dcCount = 0;
+  _amplitude = -1;
+  resetSeries(_series[RESP_BASELINE]);
+  resetSeries(_series[RESP_AMPLITUDE]);
+}
+
+void RespiratoryRate::resetSeries(Series &series)
+{
+  series.trend = -1;
+  series.offset = 0;
+  for (uint8_t x = 0 ; x < 4 ; x++) series.smooth[x] = 0;
+  series.smoothSum = 0;
+  series.smoothPos = 0;
+  series.high = 0;
+  series.low = 0;
+  series.swing = 0;
+  series.armed = false;
+  series.since = 0;
+  series.count = 0;
+}
+
+void RespiratoryRate::beat(int32_t amplitude)
+{
+  if (amplitude > 0) _amplitude = amplitude;
+}
+
+void RespiratoryRate::update(const PPGChannel &channel)
+{
+  if (channel.cycleEnded()) beat(channel.getACAmplitude());
+  update(channel.getDC());
+}
+
+void RespiratoryRate::update(int32_t dc)
+{
+  _dcSum += dc;
+  if (++_dcCount < _decimation) return;
+
+  int32_t level = _dcSum / _dcCount;
+  _dcSum = 0;
+  _dcCount = 0;
+
+  step(_series[RESP_BASELINE], level);
+  if (_amplitude > 0) step(_series[RESP_AMPLITUDE], _amplitude);
+}
+
+//One decimated sample of a series
+void RespiratoryRate::step(Series &series, int32_t value)
+{
+  //Remove the slow trend. Twice, so a steady drift doesn't leave an offset.
+  if (series.trend < 0) series.trend = value << 8;
+  series.trend += ((value << 8) - series.trend) >> _trendShift;
+  int32_t detrended = value - (series.trend >> 8);
+  series.offset += ((detrended << 8) - series.offset) >> _trendShift;
+  detrended -= series.offset >> 8;
+
+  //Smooth over about a second to take out what is left of the pulse
+  series.smoothSum += detrended - series.smooth[series.smoothPos];
+  series.smooth[series.smoothPos] = detrended;
+  series.smoothPos = (series.smoothPos + 1) & 0x03;
+  int32_t breath = series.smoothSum >> 2;
+
+  if (breath > series.high) series.high = breath;
+  if (breath < series.low) series.low = breath;
+  if (series.since < 0xFFFF) series.since++;
+
+  //Hysteresis of an eighth of the last breath so noise doesn't count
+  int32_t band = series.swing >> 3;
+  if (band < 1) band = 1;
+  if (breath < -band) series.armed = true;
+
+  if (series.armed == true && breath >= 0)
+  {
+    series.armed = false;
+    series.swing = series.high - series.low;
+    series.high = 0;
+    series.low = 0;
+
+    if (series.since >= _shortest && series.since <= _longest)
+    {
+      //Oldest interval drops out
+      for (uint8_t x = RESP_INTERVALS - 1 ; x > 0 ; x--) series.intervals[x] = series.intervals[x - 1];
+      series.intervals[0] = series.since;
+      if (series.count < RESP_INTERVALS) series.count++;
+    }
+    else if (series.since > _longest)
+    {
+      series.count = 0; //A long gap, start again
+    }
+    series.since = 0;
+  }
+
+  //No breath for twice the longest interval, the rate is no longer known
+  if (series.since > _longest * 2) series.count = 0;
+}
+
+//Breaths per minute and the spread of the intervals (longest - shortest) relative to their
+//mean, in 1/256ths, of a series with enough breaths
+bool RespiratoryRate::seriesRate(const Series &series, float &rate, uint16_t &spread) const
+{
+  rate = 0;
+  spread = 0xFFFF;
+  if (series.count < 4) return (false);
+
+  uint32_t sum = 0;
+  uint16_t shortest = 0xFFFF;
+  uint16_t longest = 0;
+  for (uint8_t x = 0 ; x < series.count ; x++)
+  {
+    sum += series.intervals[x];
+    if (series.intervals[x] < shortest) shortest = series.intervals[x];
+    if (series.intervals[x] > longest) longest = series.intervals[x];
+  }
+  spread = ((uint32_t)(longest - shortest) * series.count << 8) / sum;
+
+  //Too irregular to be breathing
+  if (spread > 128) return (false);
+
+  rate = (float)_rate * series.count / sum;
+  return (true);
+}
+
+float RespiratoryRate::getRate(uint8_t source) const
+{
+  float rate[2];
+  uint16_t spread[2];
+  bool valid[2];
+  valid[RESP_BASELINE] = seriesRate(_series[RESP_BASELINE], rate[RESP_BASELINE], spread[RESP_BASELINE]);
+  valid[RESP_AMPLITUDE] = seriesRate(_series[RESP_AMPLITUDE], rate[RESP_AMPLITUDE], spread[RESP_AMPLITUDE]);
+
+  if (source < RESP_COMBINED) return (rate[source]);
+
+  if (valid[RESP_BASELINE] && valid[RESP_AMPLITUDE])
+  {
+    float difference = rate[RESP_BASELINE] - rate[RESP_AMPLITUDE];
+    if (difference < 4 && difference > -4) return ((rate[RESP_BASELINE] + rate[RESP_AMPLITUDE]) / 2);
+
+    //Disagree, trust the steadier one
+    return (spread[RESP_BASELINE] <= spread[RESP_AMPLITUDE] ? rate[RESP_BASELINE] : rate[RESP_AMPLITUDE]);
+  }
+  if (valid[RESP_BASELINE]) return (rate[RESP_BASELINE]);
+  return (rate[RESP_AMPLITUDE]);
+}
@@ -0,0 +1,82 @@
+/*
+ Respiratory Rate from PPG
+ SparkFun Electronics
+
+ Breathing shows up in a PPG two ways: the DC level wanders up and down with each
+ breath (baseline modulation) and the pulse gets bigger and smaller (amplitude
+ modulation). RespiratoryRate follows both and times the breaths in each:
+
+  - The DC level is averaged down to about 4 samples a second
+  - Beat amplitudes are held from one beat to the next and sampled at the same rate
+  - Each series has its slow trend removed (twice, for drift) and is smoothed over one second, then
+    rising zero crossings (with hysteresis) mark breaths
+  - The last 6 breath intervals between 6 and 42 breaths per minute give a rate
+
+ If both series give a rate and they agree within 4 breaths per minute the two are
+ averaged, otherwise the steadier one is used. Nothing is buffered but the breath
+ intervals, about 150 bytes in all, and the work per sample is an add and a compare
+ with the rest once per decimated sample. It needs about 30 seconds to settle.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "ppgChannel.h"
+
+//Sources for getRate()
+#define RESP_BASELINE         0 //DC level
+#define RESP_AMPLITUDE        1 //Beat amplitude
+#define RESP_COMBINED         2
+
+class RespiratoryRate {
+ public:
+  RespiratoryRate(uint16_t sampleRate = 25);
+
+  void reset(void);
+  void update(int32_t dc); //Call with the DC level of every sample
+  void beat(int32_t amplitude); //Call with the pulse amplitude at every beat
+  void update(const PPGChannel &channel); //Or both from a PPGChannel, after its update()
+
+  float getRate(uint8_t source = RESP_COMBINED) const; //Breaths per minute, 0 if unknown
+  bool isValid(void) const { return (getRate() > 0); }
+
+ private:
+  static const uint8_t RESP_INTERVALS = 6;
+
+  struct Series
+  {
+    int32_t trend; //8 fractional bits, -1 until loaded
+    int32_t offset; //What the first trend removal leaves behind, 8 fractional bits
+    int32_t smooth[4]; //Last second of detrended values
+    int32_t smoothSum;
+    uint8_t smoothPos;
+    int32_t high; //Extremes of the current breath
+    int32_t low;
+    int32_t swing; //Peak to peak of the last breath
+    bool armed; //Gone below the hysteresis band since the last rising crossing
+    uint16_t since; //Decimated samples since the last rising crossing
+    uint16_t intervals[RESP_INTERVALS];
+    uint8_t count;
+  };
+
+  uint16_t _decimation; //Samples averaged into one
+  uint16_t _rate; //Decimated samples per minute
+  uint16_t _shortest; //Interval limits, decimated samples
+  uint16_t _longest;
+  uint8_t _trendShift;
+
+  int32_t _dcSum;
+  uint16_t _dcCount;
+  int32_t _amplitude; //Latest beat amplitude, -1 before the first beat
+
+  Series _series[2];
+
+  void resetSeries(Series &series);
+  void step(Series &series, int32_t value);
+  bool seriesRate(const Series &series, float &rate, uint16_t &spread) const;
+};
@@ -0,0 +1,151 @@
+/*
+ Binary Sample Streaming
+ SparkFun Electronics
+
+ See sampleStream.h
+*/
+
+#include "sampleStream.h"
+
+static const uint8_t STREAM_CHANNEL_BITS[3] = {STREAM_RED, STREAM_IR, STREAM_GREEN};
+
+SampleStreamEncoder::SampleStreamEncoder(void)
+{
+  _port = NULL;
+  _sensor = NULL;
+  _sampleRate = 400;
+  _sampleAverage = 4;
+  _pulseWidth = 411;
+  _adcRange = 4096;
+  _samplesPerPacket = 25;
+
+  _sequence = 0;
+  _sampleCount = 0;
+  _packets = 0;
+  _overflow = 0;
+  _count = 0;
+  _length = 0;
+  _channels = 0;
+}
+
+void SampleStreamEncoder::begin(Print &port)
+{
+  _port = &port;
+}
+
+void SampleStreamEncoder::attach(MAX30105 &sensor)
+{
+  _sensor = &sensor;
+  sensor.onSamples(samplesReceived, this);
+}
+
+void SampleStreamEncoder::samplesReceived(const SampleSpan &samples, void *context)
+{
+  SampleStreamEncoder *encoder = static_cast<SampleStreamEncoder *>(context);
+  uint16_t lost = encoder->_sensor->getOverflowCount();
+  if (lost > 0) encoder->markOverflow(lost);
+  encoder->add(samples);
+}
+
+void SampleStreamEncoder::setConfig(uint16_t sampleRate, uint8_t sampleAverage, uint16_t pulseWidth, uint16_t adcRange)
+{
+  if (_count > 0) flush(); //Samples so far were taken with the old settings
+  _sampleRate = sampleRate;
+  _sampleAverage = sampleAverage;
+  _pulseWidth = pulseWidth;
+  _adcRange = adcRange;
+}
+
+void SampleStreamEncoder::setSamplesPerPacket(uint8_t samples)
+{
+  _samplesPerPacket = samples > 0 ? samples : 1;
+}
+
+void SampleStreamEncoder::markOverflow(uint16_t lost)
+{
+  if (_count > 0) flush(); //The marker goes in the header of the packet after the gap
+  _overflow += lost;
+  _sampleCount += lost;
+}
+
+void SampleStreamEncoder::putVarint(uint32_t value)
+{
+  _length += streamPutVarint(_payload + _length, value);
+}
+
+void SampleStreamEncoder::startPacket(uint8_t channels)
+{
+  _channels = channels;
+  _length = 0;
+  _payload[_length++] = STREAM_PACKET_SAMPLES;
+  _payload[_length++] = _sequence;
+  _payload[_length++] = channels;
+  putVarint(_sampleRate);
+  _payload[_length++] = _sampleAverage;
+  putVarint(_pulseWidth);
+  putVarint(_adcRange);
+  putVarint(_sampleCount);
+  putVarint(_overflow);
+  _countAt = _length++;
+
+  _overflow = 0;
+  _previous[0] = _previous[1] = _previous[2] = 0;
+}
+
+void SampleStreamEncoder::add(const SampleSpan &samples)
+{
+  uint8_t channels = 0;
+  if (samples.redRow) channels |= STREAM_RED;
+  if (samples.irRow) channels |= STREAM_IR;
+  if (samples.greenRow) channels |= STREAM_GREEN;
+
+  for (uint8_t x = 0 ; x < samples.count ; x++)
+    add(channels, samples.red(x), samples.IR(x), samples.green(x));
+}
+
+void SampleStreamEncoder::add(uint8_t channels, uint32_t red, uint32_t ir, uint32_t green)
+{
+  channels &= STREAM_RED | STREAM_IR | STREAM_GREEN;
+  if (channels == 0) return;
+
+  //A reading is at most 3 bytes: an 18-bit difference zigzags to 19 bits
+  if (_count > 0 && (channels != _channels || _length + 9 > STREAM_MAX_PAYLOAD)) flush();
+  if (_count == 0) startPacket(channels);
+
+  uint32_t values[3] = {red, ir, green};
+  for (uint8_t x = 0 ; x < 3 ; x++)
+  {
+    if ((channels & STREAM_CHANNEL_BITS[x]) == 0) continue;
+    uint32_t value = values[x] & 0x3FFFF;
+    putVarint(streamZigzag((int32_t)(value - _previous[x])));
+    _previous[x] = value;
+  }
+
+  _count++;
+  _sampleCount++;
+  if (_count >= _samplesPerPacket) flush();
+}
+
+void SampleStreamEncoder::flush(void)
+{
+  if (_count == 0) return;
+
+  _payload[_countAt] = _count;
+
+  uint8_t header[3] = {STREAM_SYNC1, STREAM_SYNC2, _length};
+  uint16_t crc = streamCRC(0xFFFF, &header[2], 1);
+  crc = streamCRC(crc, _payload, _length);
+  uint8_t trailer[2] = {(uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+
+  if (_port != NULL)
+  {
+    _port->write(header, 3);
+    _port->write(_payload, _length);
+    _port->write(trailer, 2);
+  }
+
+  _sequence++;
+  _packets++;
+  _count = 0;
+  _length = 0;
+}
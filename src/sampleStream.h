@@ -0,0 +1,73 @@
+/*
+ Binary Sample Streaming
+ SparkFun Electronics
+
+ Printing readings as text takes around 25 bytes a sample, and the time spent in
+ Serial.print() lets the FIFO overflow at high sample rates (see Example9_RateTesting).
+ SampleStreamEncoder sends the same samples as small binary packets instead, and
+ SampleStreamDecoder (sampleStreamDecoder.h, which builds without Arduino) turns
+ a received byte stream back into samples on the host.
+
+ The packet format is described in sampleStreamDecoder.h.
+
+ A slowly changing 18-bit reading takes 1 or 2 bytes, so Red+IR at 400 samples
+ per second needs around 1.5kB/s including packet overhead.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "MAX30105.h"
+#include "sampleStreamDecoder.h" //Packet format, CRC and varints shared with the decoder
+
+class SampleStreamEncoder {
+ public:
+  SampleStreamEncoder(void);
+
+  void begin(Print &port); //Where packets are written, Serial for example
+  void attach(MAX30105 &sensor); //Encode every block check() reads, overflows included
+
+  //The settings given to setup(), repeated in every packet header
+  void setConfig(uint16_t sampleRate, uint8_t sampleAverage, uint16_t pulseWidth, uint16_t adcRange);
+  void setSamplesPerPacket(uint8_t samples); //Send a packet after this many samples, default 25
+
+  void add(const SampleSpan &samples);
+  void add(uint8_t channels, uint32_t red, uint32_t ir = 0, uint32_t green = 0); //One sample, channels is STREAM_* bits
+  void markOverflow(uint16_t lost); //Samples lost before the next one added
+  void flush(void); //Send what we have now
+
+  uint32_t getSampleCount(void) const { return (_sampleCount); }
+  uint32_t getPacketCount(void) const { return (_packets); }
+
+ private:
+  Print *_port;
+  MAX30105 *_sensor;
+
+  uint16_t _sampleRate;
+  uint8_t _sampleAverage;
+  uint16_t _pulseWidth;
+  uint16_t _adcRange;
+  uint8_t _samplesPerPacket;
+
+  uint8_t _sequence;
+  uint32_t _sampleCount; //Index of the next sample, lost samples included
+  uint32_t _packets;
+  uint32_t _overflow; //Lost samples waiting to be reported
+
+  //The packet being built
+  uint8_t _payload[STREAM_MAX_PAYLOAD];
+  uint8_t _length;
+  uint8_t _channels;
+  uint8_t _count;
+  uint8_t _countAt; //Where count goes in _payload
+  uint32_t _previous[3];
+
+  static void samplesReceived(const SampleSpan &samples, void *context);
+  void startPacket(uint8_t channels);
+  void putVarint(uint32_t value);
+};
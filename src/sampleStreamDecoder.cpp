@@ -0,0 +1,184 @@
+/*
+ Binary Sample Stream Format and Decoder
+ SparkFun Electronics
+
+ See sampleStreamDecoder.h
+*/
+
+#include <string.h>
+
+#include "sampleStreamDecoder.h"
+
+//Decoder states
+static const uint8_t STREAM_WAIT_SYNC1 = 0;
+static const uint8_t STREAM_WAIT_SYNC2 = 1;
+static const uint8_t STREAM_IN_FRAME = 2;
+
+static const uint8_t STREAM_CHANNEL_BITS[3] = {STREAM_RED, STREAM_IR, STREAM_GREEN};
+
+//CRC-16/CCITT, bit at a time to keep tables out of RAM
+uint16_t streamCRC(uint16_t crc, const uint8_t *data, uint16_t length)
+{
+  while (length-- > 0)
+  {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t x = 0 ; x < 8 ; x++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return (crc);
+}
+
+SampleStreamDecoder::SampleStreamDecoder(void)
+{
+  _callback = NULL;
+  _context = NULL;
+  reset();
+}
+
+void SampleStreamDecoder::onPacket(StreamPacketCallback callback, void *context)
+{
+  _context = context;
+  _callback = callback;
+}
+
+void SampleStreamDecoder::reset(void)
+{
+  _state = STREAM_WAIT_SYNC1;
+  _have = 0;
+  _started = false;
+  _expected = 0;
+  _packets = 0;
+  _crcErrors = 0;
+  _skipped = 0;
+  _lost = 0;
+}
+
+void SampleStreamDecoder::push(const uint8_t *data, size_t length)
+{
+  while (length-- > 0) push(*data++);
+}
+
+void SampleStreamDecoder::push(uint8_t data)
+{
+  if (step(data) == false) return;
+
+  //Corrupt or a false sync. Look for a packet in what followed the sync bytes by running them through
+  //again. A frame that fails during the rescan is made of bytes from this copy, so the loop starts
+  //again at its first byte rather than recursing, and every restart is at least a sync pair further on.
+  uint8_t copy[sizeof(_frame)];
+  uint16_t count = _have;
+  memcpy(copy, _frame, count);
+
+  uint16_t x = 0;
+  while (x < count)
+  {
+    x++;
+    if (step(copy[x - 1]) == true) x -= _have;
+  }
+}
+
+//Run one byte through the framing, returns true if it completed a frame that failed its CRC or parse
+bool SampleStreamDecoder::step(uint8_t data)
+{
+  if (_state == STREAM_WAIT_SYNC1)
+  {
+    if (data == STREAM_SYNC1) _state = STREAM_WAIT_SYNC2;
+    else _skipped++;
+    return (false);
+  }
+
+  if (_state == STREAM_WAIT_SYNC2)
+  {
+    if (data == STREAM_SYNC2)
+    {
+      _state = STREAM_IN_FRAME;
+      _have = 0;
+    }
+    else if (data == STREAM_SYNC1) _skipped++; //The earlier one wasn't a sync, this may be
+    else
+    {
+      _skipped += 2;
+      _state = STREAM_WAIT_SYNC1;
+    }
+    return (false);
+  }
+
+  _frame[_have++] = data;
+  if (_have == 1 && (data == 0 || data > STREAM_MAX_PAYLOAD))
+  {
+    //Not a length we would send, this wasn't a real sync
+    _skipped += 3;
+    _state = STREAM_WAIT_SYNC1;
+    return (false);
+  }
+  if (_have < (uint16_t)_frame[0] + 3) return (false);
+  return (frameDone() == false);
+}
+
+//Returns true if the frame held a packet
+bool SampleStreamDecoder::frameDone(void)
+{
+  uint8_t length = _frame[0];
+  uint16_t crc = streamCRC(0xFFFF, _frame, length + 1);
+  uint16_t sent = _frame[length + 1] | ((uint16_t)_frame[length + 2] << 8);
+  _state = STREAM_WAIT_SYNC1;
+
+  if (crc == sent && parse(_frame + 1, length)) return (true);
+
+  _crcErrors++;
+  _skipped += 2;
+  return (false);
+}
+
+bool SampleStreamDecoder::parse(const uint8_t *payload, uint8_t length)
+{
+  const uint8_t *p = payload;
+  const uint8_t *end = payload + length;
+  uint32_t value;
+  StreamPacket &packet = _packet;
+
+  if (length < 3 || p[0] != STREAM_PACKET_SAMPLES) return (false);
+  packet.sequence = p[1];
+  packet.channels = p[2] & (STREAM_RED | STREAM_IR | STREAM_GREEN);
+  p += 3;
+
+  if (streamGetVarint(p, end, value) == false) return (false);
+  packet.sampleRate = value;
+  if (p >= end) return (false);
+  packet.sampleAverage = *p++;
+  if (streamGetVarint(p, end, value) == false) return (false);
+  packet.pulseWidth = value;
+  if (streamGetVarint(p, end, value) == false) return (false);
+  packet.adcRange = value;
+  if (streamGetVarint(p, end, packet.first) == false) return (false);
+  if (streamGetVarint(p, end, packet.overflow) == false) return (false);
+  if (p >= end) return (false);
+  packet.count = *p++;
+  if (packet.count > STREAM_MAX_SAMPLES) return (false);
+
+  packet.channelCount = 0;
+  for (uint8_t x = 0 ; x < 3 ; x++)
+    if (packet.channels & STREAM_CHANNEL_BITS[x]) packet.channelCount++;
+
+  uint32_t previous[3] = {0, 0, 0};
+  for (uint8_t n = 0 ; n < packet.count ; n++)
+  {
+    for (uint8_t row = 0 ; row < packet.channelCount ; row++)
+    {
+      if (streamGetVarint(p, end, value) == false) return (false);
+      previous[row] += streamUnzigzag(value);
+      packet.samples[row][n] = previous[row] & 0x3FFFF;
+    }
+  }
+  if (p != end) return (false);
+
+  //Samples between the last packet and this one never arrived
+  if (_started == true && packet.first > _expected) _lost += packet.first - _expected;
+  else if (_started == false) _lost += packet.overflow;
+  _started = true;
+  _expected = packet.first + packet.count;
+  _packets++;
+
+  if (_callback != NULL) _callback(packet, _context);
+  return (true);
+}
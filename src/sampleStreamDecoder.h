@@ -0,0 +1,153 @@
+/*
+ Binary Sample Stream Format and Decoder
+ SparkFun Electronics
+
+ The packet format SampleStreamEncoder (sampleStream.h) sends, and
+ SampleStreamDecoder, which turns a received byte stream back into samples on
+ the host. Only the C standard headers are needed, so a host program builds the
+ decoder from this header and sampleStreamDecoder.cpp without an Arduino core.
+
+ Packet:
+   0xA5 0x5A          sync
+   length             payload bytes, 1 byte
+   payload
+   CRC                CRC-16/CCITT (0x1021, start 0xFFFF) of length and payload, low byte first
+
+ Payload, varints are unsigned LEB128:
+   type               STREAM_PACKET_SAMPLES
+   sequence           counts up by one per packet
+   channels           STREAM_RED | STREAM_IR | STREAM_GREEN
+   sampleRate         varint, as given to setup()
+   sampleAverage
+   pulseWidth         varint
+   adcRange           varint
+   first              varint, index of the first sample since begin()
+   overflow           varint, samples lost just before the first sample of this packet
+   count              samples per channel
+   samples            for each sample, for each channel in red, IR, green order:
+                      the difference from that channel's previous sample, zigzag
+                      encoded then as a varint. The previous value is 0 at the start
+                      of each packet so every packet decodes on its own.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define STREAM_SYNC1            0xA5
+#define STREAM_SYNC2            0x5A
+#define STREAM_PACKET_SAMPLES   0x01
+
+//Channel bits in the packet header
+#define STREAM_RED              0x01
+#define STREAM_IR               0x02
+#define STREAM_GREEN            0x04
+
+#define STREAM_MAX_PAYLOAD      128 //Payload bytes a packet can carry, 255 at most
+#define STREAM_MAX_SAMPLES      STREAM_MAX_PAYLOAD //Enough for 1 byte per reading of a single channel
+
+uint16_t streamCRC(uint16_t crc, const uint8_t *data, uint16_t length);
+
+//Small differences become small numbers: 0, -1, 1, -2, 2 ... to 0, 1, 2, 3, 4 ...
+static inline uint32_t streamZigzag(int32_t value)
+{
+  return (((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline int32_t streamUnzigzag(uint32_t value)
+{
+  return ((int32_t)(value >> 1) ^ -(int32_t)(value & 1));
+}
+
+//Write value as a varint at out, returns the bytes written (at most 5)
+static inline uint8_t streamPutVarint(uint8_t *out, uint32_t value)
+{
+  uint8_t length = 0;
+  while (value >= 0x80)
+  {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return (length);
+}
+
+//Read a varint at p, moving p past it. False if it runs past end or is longer than 5 bytes.
+static inline bool streamGetVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+  value = 0;
+  for (uint8_t shift = 0 ; shift < 35 ; shift += 7)
+  {
+    if (p >= end) return (false);
+    uint8_t b = *p++;
+    value |= (uint32_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) return (true);
+  }
+  return (false);
+}
+
+//Everything in one received packet. samples[] has a row per channel in the packet,
+//row 0 is the first channel present (red if STREAM_RED is set).
+struct StreamPacket
+{
+  uint8_t sequence;
+  uint8_t channels; //STREAM_* bits
+  uint8_t channelCount;
+  uint16_t sampleRate;
+  uint8_t sampleAverage;
+  uint16_t pulseWidth;
+  uint16_t adcRange;
+  uint32_t first;
+  uint32_t overflow;
+  uint8_t count;
+  uint32_t samples[3][STREAM_MAX_SAMPLES];
+
+  //Readings of one channel, NULL if it isn't in the packet
+  const uint32_t *channel(uint8_t bit) const
+  {
+    if ((channels & bit) == 0) return (NULL);
+    uint8_t row = 0;
+    for (uint8_t b = STREAM_RED ; b < bit ; b <<= 1) if (channels & b) row++;
+    return (samples[row]);
+  }
+};
+
+typedef void (*StreamPacketCallback)(const StreamPacket &packet, void *context);
+
+class SampleStreamDecoder {
+ public:
+  SampleStreamDecoder(void);
+
+  void onPacket(StreamPacketCallback callback, void *context = NULL);
+  void reset(void);
+
+  void push(uint8_t data); //Feed received bytes in any sized pieces
+  void push(const uint8_t *data, size_t length);
+
+  uint32_t getPacketCount(void) const { return (_packets); }
+  uint32_t getCRCErrors(void) const { return (_crcErrors); }
+  uint32_t getBytesSkipped(void) const { return (_skipped); } //Bytes discarded looking for a packet
+  uint32_t getLostSamples(void) const { return (_lost); } //From overflow markers and missing packets
+
+ private:
+  StreamPacketCallback _callback;
+  void *_context;
+
+  uint8_t _state;
+  uint8_t _frame[STREAM_MAX_PAYLOAD + 3]; //Length, payload and CRC
+  uint16_t _have;
+
+  StreamPacket _packet;
+  bool _started;
+  uint32_t _expected; //First sample of the next packet
+
+  uint32_t _packets;
+  uint32_t _crcErrors;
+  uint32_t _skipped;
+  uint32_t _lost;
+
+  bool step(uint8_t data);
+  bool frameDone(void);
+  bool parse(const uint8_t *payload, uint8_t length);
+};
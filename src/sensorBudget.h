@@ -0,0 +1,136 @@
+/*
+ LED power and I2C bandwidth budget for a setup() configuration
+ SparkFun Electronics
+
+ Give SensorBudget the same arguments as setup(), plus the I2C clock, how often
+ check() is called and the Wire read size, and it estimates:
+  - LED charge per second, the average current drawn by the LEDs
+  - I2C bytes and clocks per second needed to keep up with the FIFO
+  - How long the 32 record FIFO takes to fill, and so how late check() can be
+
+ feasibility() reports combinations setup() would quietly change, pulse widths
+ too long for the sample rate, a bus too slow for the data and a polling interval
+ that lets the FIFO overflow. Everything is constexpr, so a configuration can be
+ checked when the sketch is compiled:
+
+   constexpr SensorBudget budget(0x1F, 4, 2, 400, 411, I2C_SPEED_FAST, 20);
+   static_assert(budget.feasible(), "FIFO can't be drained");
+
+ Bus figures count every address, register and data byte at 9 clocks, plus 2
+ clocks of start and stop per transaction, and round up. Treat them as upper bounds.
+*/
+
+#pragma once
+
+#include "MAX30105.h"
+
+//feasibility() bits. BUDGET_OK means the configuration works.
+#define BUDGET_OK                 0x00
+#define BUDGET_BAD_SETTING        0x01 //A value setup() doesn't support and would replace, or a bus over 400kHz
+#define BUDGET_PULSE_TOO_LONG     0x02 //The LED slots don't fit in one sample period at this pulse width
+#define BUDGET_BUS_TOO_SLOW       0x04 //The I2C clock can't carry the samples
+#define BUDGET_POLL_TOO_SLOW      0x08 //The FIFO overflows between calls to check()
+
+#define BUDGET_FIFO_DEPTH         32 //Records the FIFO holds
+#define BUDGET_MAX_I2C_SPEED      400000
+
+class SensorBudget
+{
+ public:
+  constexpr SensorBudget(byte powerLevel = 0x1F, byte sampleAverage = 4, byte ledMode = 3, int sampleRate = 400, int pulseWidth = 411,
+                         uint32_t i2cSpeed = I2C_SPEED_STANDARD, uint16_t pollMillis = 10, uint8_t readSize = I2C_BUFFER_LENGTH)
+    : _powerLevel(powerLevel), _sampleAverage(sampleAverage), _ledMode(ledMode), _sampleRate(sampleRate), _pulseWidth(pulseWidth),
+      _i2cSpeed(i2cSpeed), _pollMillis(pollMillis > 0 ? pollMillis : 1), _readSize(readSize > 0 ? readSize : 1) {}
+
+  //LEDs pulsed each sample, as setup() assigns them to slots
+  constexpr uint8_t slots(void) const { return (_ledMode == 3 ? 3 : (_ledMode == 2 ? 2 : 1)); }
+  constexpr uint8_t recordBytes(void) const { return (slots() * 3); }
+
+  //Current of one LED pulse, 0.2mA per step of powerLevel
+  constexpr uint32_t ledCurrentMicroamps(void) const { return ((uint32_t)_powerLevel * 200); }
+
+  //Charge all LEDs draw in one second in uC, which is also their average current in uA
+  constexpr uint32_t ledChargePerSecond(void) const
+  { return (((uint32_t)_powerLevel * _pulseWidth * validRate() * slots() + 2500) / 5000); }
+
+  //Records per second after averaging, rounded up
+  constexpr uint16_t recordsPerSecond(void) const { return ((validRate() + sampleAverage() - 1) / sampleAverage()); }
+
+  //FIFO data check() reads in one second
+  constexpr uint32_t dataBytesPerSecond(void) const { return (((uint32_t)validRate() * recordBytes() + sampleAverage() - 1) / sampleAverage()); }
+
+  //Everything on the bus in one second: the pointer read on every check(), and the FIFO reads on the ones that find data
+  constexpr uint32_t busBytesPerSecond(void) const
+  { return (6 * pollsPerSecond() + 2 * dataPollsPerSecond() + fifoReadsPerSecond() + dataBytesPerSecond()); }
+  constexpr uint32_t busTransactionsPerSecond(void) const
+  { return (2 * pollsPerSecond() + dataPollsPerSecond() + fifoReadsPerSecond()); }
+
+  //Slowest I2C clock that keeps up, in Hz, with the bus doing nothing else
+  constexpr uint32_t minBusClock(void) const { return (9 * busBytesPerSecond() + 2 * busTransactionsPerSecond()); }
+
+  //Time for an empty FIFO to fill
+  constexpr uint32_t fifoFillMicros(void) const { return ((uint32_t)BUDGET_FIFO_DEPTH * sampleAverage() * 1000000UL / validRate()); }
+
+  //Time check() takes to read a full FIFO at this bus clock
+  constexpr uint32_t fifoDrainMicros(void) const { return (drainClocks(BUDGET_FIFO_DEPTH) * 1000UL / busKilohertz()); }
+
+  //Longest the host can leave between calls to check() without losing samples
+  constexpr uint32_t maxServiceLatencyMicros(void) const
+  { return (fifoFillMicros() > fifoDrainMicros() ? fifoFillMicros() - fifoDrainMicros() : 0); }
+
+  //BUDGET_OK or a combination of the bits above
+  constexpr uint8_t feasibility(void) const
+  {
+    return ((validSettings() ? 0 : BUDGET_BAD_SETTING) |
+            (validSettings() && _sampleRate > maxSampleRate(slots(), _pulseWidth) ? BUDGET_PULSE_TOO_LONG : 0) |
+            (minBusClock() > _i2cSpeed ? BUDGET_BUS_TOO_SLOW : 0) |
+            ((uint32_t)_pollMillis * 1000 > maxServiceLatencyMicros() ? BUDGET_POLL_TOO_SLOW : 0));
+  }
+  constexpr bool feasible(void) const { return (feasibility() == BUDGET_OK); }
+
+  //Highest sample rate the part allows with this many LED slots and pulse width, 0 if the pulse width isn't one setup() takes.
+  //One and two slots follow the datasheet's HR and SpO2 mode tables. Three slots use the two slot
+  //limits, which setup()'s default of three LEDs at 400sps and 411us runs at.
+  static constexpr int maxSampleRate(uint8_t slots, int pulseWidth)
+  {
+    return (slots <= 1 ? (pulseWidth == 69 ? 3200 : pulseWidth == 118 ? 1600 : pulseWidth == 215 ? 1600 : pulseWidth == 411 ? 1000 : 0) :
+                         (pulseWidth == 69 ? 1600 : pulseWidth == 118 ? 1000 : pulseWidth == 215 ? 800 : pulseWidth == 411 ? 400 : 0));
+  }
+
+ private:
+  byte _powerLevel;
+  byte _sampleAverage;
+  byte _ledMode;
+  int _sampleRate;
+  int _pulseWidth;
+  uint32_t _i2cSpeed;
+  uint16_t _pollMillis;
+  uint8_t _readSize;
+
+  //Bad settings still give numbers, from the defaults setup() falls back to
+  constexpr uint8_t sampleAverage(void) const
+  { return (_sampleAverage == 1 || _sampleAverage == 2 || _sampleAverage == 8 || _sampleAverage == 16 || _sampleAverage == 32 ? _sampleAverage : 4); }
+  constexpr uint16_t validRate(void) const { return (_sampleRate > 0 && _sampleRate <= 3200 ? _sampleRate : 50); }
+  constexpr uint32_t busKilohertz(void) const { return (_i2cSpeed >= 1000 ? _i2cSpeed / 1000 : 1); }
+
+  constexpr bool validSettings(void) const
+  {
+    return (sampleAverage() == _sampleAverage && _ledMode >= 1 && _ledMode <= 3 &&
+            (_sampleRate == 50 || _sampleRate == 100 || _sampleRate == 200 || _sampleRate == 400 ||
+             _sampleRate == 800 || _sampleRate == 1000 || _sampleRate == 1600 || _sampleRate == 3200) &&
+            maxSampleRate(1, _pulseWidth) > 0 && _i2cSpeed <= BUDGET_MAX_I2C_SPEED);
+  }
+
+  constexpr uint32_t pollsPerSecond(void) const { return ((1000 + _pollMillis - 1) / _pollMillis); }
+  //Only calls that find new records read the FIFO
+  constexpr uint32_t dataPollsPerSecond(void) const { return (pollsPerSecond() < recordsPerSecond() ? pollsPerSecond() : recordsPerSecond()); }
+  //Each of those reads in blocks of _readSize, at most one short block each
+  constexpr uint32_t fifoReadsPerSecond(void) const { return (dataPollsPerSecond() + dataBytesPerSecond() / _readSize); }
+
+  //Bus clocks for one check() that reads this many records: pointers, FIFO address, FIFO blocks
+  constexpr uint32_t drainClocks(uint16_t records) const
+  {
+    return (9 * (6 + 2 + drainReads(records) + (uint32_t)records * recordBytes()) + 2 * (3 + drainReads(records)));
+  }
+  constexpr uint32_t drainReads(uint16_t records) const { return (((uint32_t)records * recordBytes() + _readSize - 1) / _readSize); }
+};
@@ -0,0 +1,161 @@
+/*
+ Streaming Signal Quality Index
+ SparkFun Electronics
+
+ See signalQuality.h
+*/
+
+#include "signalQuality.h"
+
+SignalQuality::SignalQuality(uint16_t sampleRate)
+{
+  _sampleRate = sampleRate > 0 ? sampleRate : 1;
+  _minDC = 50000; //Same no-finger level as Example5_HeartRate
+  _maxDC = 250000;
+  _clipLevel = 0x3FF00; //18-bit ceiling less a small margin
+  _minAC = 50;
+
+  reset();
+}
+
+void SignalQuality::reset(void)
+{
+  _dc = -1; //Loaded from the first sample
+  _acMax = 0;
+  _acMin = 0;
+  _acAmplitude = 0;
+
+  _sinceCrossing = 0;
+  _intervalCount = 0;
+  _armed = false;
+  _regular = false;
+
+  _clipHold = 0;
+  _alcHold = 0;
+}
+
+void SignalQuality::setDCRange(uint32_t minimum, uint32_t maximum)
+{
+  _minDC = minimum;
+  _maxDC = maximum;
+}
+
+void SignalQuality::setClipLevel(uint32_t level)
+{
+  _clipLevel = level;
+}
+
+void SignalQuality::setMinimumAC(int32_t amplitude)
+{
+  _minAC = amplitude;
+}
+
+//Hold the overflow for one second after INT1 reports it
+void SignalQuality::reportALCOverflow(void)
+{
+  _alcHold = _sampleRate;
+}
+
+void SignalQuality::update(uint32_t sample)
+{
+  sample &= 0x3FFFF; //Readings are 18 bits
+
+  //DC estimate, same time constant as averageDCEstimator()
+  if (_dc < 0) _dc = (int32_t)sample << 8;
+  _dc += (((int32_t)sample << 8) - _dc) >> 4;
+  int32_t ac = (int32_t)sample - (_dc >> 8);
+
+  if (ac > _acMax) _acMax = ac;
+  if (ac < _acMin) _acMin = ac;
+
+  //Hysteresis so noise around zero doesn't count as crossings
+  int32_t band = _acAmplitude >> 3;
+  if (band < 4) band = 4;
+  if (ac < -band) _armed = true;
+
+  //Rising zero crossing ends a cycle
+  bool cycleEnded = false;
+  if (_armed == true && ac >= 0)
+  {
+    _armed = false;
+    cycleEnded = true;
+    _acAmplitude = _acMax - _acMin;
+    _acMax = 0;
+    _acMin = 0;
+  }
+
+  updateTiming(sample, cycleEnded);
+
+  //No crossing for longer than 30bpm allows, there's no pulse
+  if (_sinceCrossing > (uint32_t)_sampleRate * 2)
+    _acAmplitude = _acMax - _acMin;
+}
+
+//Take the DC, AC amplitude and cycle ends from a shared preprocessing stage instead of working them out again
+void SignalQuality::update(const PPGChannel &channel)
+{
+  _dc = channel.getDC() << 8;
+  _acAmplitude = channel.getACAmplitude();
+  updateTiming(channel.getSample(), channel.cycleEnded());
+}
+
+//Clip and ALC hold times and zero crossing regularity
+void SignalQuality::updateTiming(uint32_t sample, bool cycleEnded)
+{
+  if (sample >= _clipLevel) _clipHold = _sampleRate; //Report clipping for one second
+  else if (_clipHold > 0) _clipHold--;
+  if (_alcHold > 0) _alcHold--;
+
+  if (_sinceCrossing < 0xFFFF) _sinceCrossing++;
+
+  if (cycleEnded == true)
+  {
+    _intervals[_intervalCount & 0x03] = _sinceCrossing;
+    if (_intervalCount < 0xFF) _intervalCount++;
+    _sinceCrossing = 0;
+
+    //Regular if the last four cycles are 30 to 240bpm and within +/-25% of their mean
+    _regular = false;
+    if (_intervalCount >= 4)
+    {
+      uint16_t shortest = _intervals[0];
+      uint16_t longest = _intervals[0];
+      uint32_t sum = _intervals[0];
+      for (uint8_t x = 1 ; x < 4 ; x++)
+      {
+        if (_intervals[x] < shortest) shortest = _intervals[x];
+        if (_intervals[x] > longest) longest = _intervals[x];
+        sum += _intervals[x];
+      }
+      //4 * interval >= rate / 4 (240bpm) and interval <= 2 * rate (30bpm)
+      if ((uint32_t)shortest * 4 >= _sampleRate && longest <= (uint32_t)_sampleRate * 2
+          && (uint32_t)(longest - shortest) * 8 <= sum)
+        _regular = true;
+    }
+  }
+
+  if (_sinceCrossing > (uint32_t)_sampleRate * 2) _regular = false;
+}
+
+uint8_t SignalQuality::status(void) const
+{
+  uint8_t flags = SQ_GOOD;
+  uint32_t dc = _dc < 0 ? 0 : (uint32_t)(_dc >> 8);
+
+  if (dc < _minDC) flags |= SQ_NO_CONTACT;
+  if (dc > _maxDC) flags |= SQ_DC_HIGH;
+  if (_clipHold > 0) flags |= SQ_SATURATED;
+  if (_acAmplitude < _minAC) flags |= SQ_LOW_PERFUSION;
+  if (_alcHold > 0) flags |= SQ_ALC_OVERFLOW;
+  if (_regular == false) flags |= SQ_IRREGULAR;
+
+  return (flags);
+}
+
+bool checkForBeat(BeatDetector &detector, int32_t sample, const SignalQuality &quality, uint8_t mask)
+{
+  //Keep the DC estimate and filter history up to date through bad stretches, so the first samples
+  //after one aren't compared against an old DC level. Only the beat is hidden.
+  bool beat = checkForBeat(detector, sample);
+  return (beat && quality.isGood(mask));
+}
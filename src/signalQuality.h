@@ -0,0 +1,106 @@
+/*
+ Streaming Signal Quality Index
+ SparkFun Electronics
+
+ A cheap per-sample check of one PPG channel (IR or red) so the beat detector
+ and SpO2 calculation can be skipped when they cannot give a good answer, and
+ so we can tell the user why there is no reading.
+
+ Checks, each reported as a bit in status():
+  - DC level in range (finger present but not pressed hard enough to saturate)
+  - AC amplitude big enough to find beats in
+  - Samples clipping near the top of the 18-bit ADC
+  - Ambient light cancellation overflow (reported from the INT1 register)
+  - Zero crossing intervals regular and within a plausible heart rate
+
+ update() is a handful of adds and compares, no multiplies or divides.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "heartRate.h"
+#include "spo2_algorithm.h"
+#include "ppgChannel.h"
+
+//Status bits. SQ_GOOD means nothing is wrong.
+#define SQ_GOOD             0x00
+#define SQ_NO_CONTACT       0x01 //DC below the minimum, no finger?
+#define SQ_DC_HIGH          0x02 //DC above the maximum
+#define SQ_SATURATED        0x04 //Samples clipped at the ADC ceiling recently
+#define SQ_LOW_PERFUSION    0x08 //AC amplitude too small
+#define SQ_ALC_OVERFLOW     0x10 //Ambient light cancellation overflowed recently
+#define SQ_IRREGULAR        0x20 //Zero crossings irregular or outside 30-240bpm, motion?
+#define SQ_ALL              0x3F
+
+class SignalQuality {
+ public:
+  SignalQuality(uint16_t sampleRate = 25);
+
+  void reset(void);
+  void update(uint32_t sample); //Call with every sample of this channel
+  void update(const PPGChannel &channel); //Or after every PPGChannel::update() to share its DC/AC work
+  void reportALCOverflow(void); //Call when getINT1() has the ALC_OVF bit (0x20) set
+
+  uint8_t status(void) const; //SQ_GOOD or a combination of the bits above
+  bool isGood(uint8_t mask = SQ_ALL) const { return ((status() & mask) == 0); }
+
+  int32_t getDC(void) const { return (_dc < 0 ? 0 : _dc >> 8); }
+  int32_t getACAmplitude(void) const { return (_acAmplitude); } //Peak to peak of the last cycle
+
+  void setDCRange(uint32_t minimum, uint32_t maximum); //Default 50000 to 250000
+  void setClipLevel(uint32_t level); //Default 0x3FF00. Lower it for pulse widths under 411us (fewer ADC bits)
+  void setMinimumAC(int32_t amplitude); //Default 50 counts peak to peak
+
+ private:
+  uint16_t _sampleRate;
+  uint32_t _minDC;
+  uint32_t _maxDC;
+  uint32_t _clipLevel;
+  int32_t _minAC;
+
+  int32_t _dc; //DC estimate, 8 fractional bits
+  int32_t _acMax; //AC extremes of the current cycle
+  int32_t _acMin;
+  int32_t _acAmplitude;
+
+  //Zero crossing regularity
+  uint16_t _sinceCrossing;
+  uint16_t _intervals[4];
+  uint8_t _intervalCount;
+  bool _armed; //AC has gone below the hysteresis band since the last up crossing
+  bool _regular;
+
+  uint16_t _clipHold; //Samples left to report SQ_SATURATED
+  uint16_t _alcHold; //Samples left to report SQ_ALC_OVERFLOW
+
+  void updateTiming(uint32_t sample, bool cycleEnded);
+};
+
+//Run checkForBeat() on every sample, but only report beats while the channel is good
+bool checkForBeat(BeatDetector &detector, int32_t sample, const SignalQuality &quality, uint8_t mask = SQ_ALL);
+
+//Run the SpO2/HR calculation only when both channels are good
+//Returns SQ_GOOD if it ran, otherwise the status bits that stopped it. The outputs are then -999 and not valid.
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+uint8_t maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid,
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid, const SignalQuality &irQuality, const SignalQuality &redQuality, uint8_t mask = SQ_ALL)
+{
+  uint8_t reason = (irQuality.status() | redQuality.status()) & mask;
+  if (reason != SQ_GOOD)
+  {
+    *pn_spo2 = -999;
+    *pch_spo2_valid = 0;
+    *pn_heart_rate = -999;
+    *pch_hr_valid = 0;
+    return (reason);
+  }
+
+  maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+  return (SQ_GOOD);
+}
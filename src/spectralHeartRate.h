@@ -0,0 +1,167 @@
+/*
+ Spectral Heart Rate Estimator
+ SparkFun Electronics
+
+ checkForBeat() and the SpO2 code both time individual beats, so one missed or
+ extra beat throws the rate off. SpectralHeartRate instead tracks the strongest
+ frequency between 0.5 and 4Hz (30 to 240bpm) over the last WINDOW samples.
+
+ A sliding DFT updates only the bins in that band with each sample, in integer
+ arithmetic: four multiplies per bin and no FFT. The bins are damped by a factor
+ just under one so rounding errors die away instead of building up. When the rate
+ is asked for, a Hann window is applied to the bins, the peak is found and
+ interpolated between bins on a log scale. If half the peak frequency is nearly as strong the
+ lower one is taken, as the pulse's second harmonic can outgrow the fundamental.
+
+ Bins are FREQ / WINDOW Hz apart, 0.1Hz (6bpm) for 256 samples at 25Hz, and the
+ interpolation resolves well inside a bin. Memory is 2 * WINDOW bytes of history
+ plus 12 bytes a bin, about 1K at the defaults. Use WINDOW = 128 on AVR.
+
+ It runs alongside checkForBeat(): feed it the same PPGChannel.
+*/
+
+#pragma once
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include <math.h>
+
+#include "ppgChannel.h"
+
+template <uint16_t FREQ = 25, uint16_t WINDOW = 256>
+class SpectralHeartRate {
+ public:
+  //Bins covering 0.5 to 4Hz, and one more each side for the Hann window
+  static const uint16_t LOW_BIN = (uint32_t)WINDOW / (2 * FREQ);
+  static const uint16_t HIGH_BIN = ((uint32_t)WINDOW * 4 + FREQ - 1) / FREQ;
+  static const uint16_t BINS = HIGH_BIN - LOW_BIN + 3;
+
+  static_assert(LOW_BIN >= 2, "WINDOW too short to resolve 0.5Hz at this FREQ");
+  static_assert(HIGH_BIN + 1 < WINDOW / 2, "FREQ too low to see 4Hz");
+
+  SpectralHeartRate(void)
+  {
+    //Each bin's rotation times the damping r, in Q15
+    const float r = 1.0f - 1.0f / 8192;
+    for (uint16_t b = 0 ; b < BINS ; b++)
+    {
+      float angle = 2.0f * (float)M_PI * (LOW_BIN - 1 + b) / WINDOW;
+      _cos[b] = (int16_t)lroundf(r * cosf(angle) * 32768.0f);
+      _sin[b] = (int16_t)lroundf(r * sinf(angle) * 32768.0f);
+    }
+    _rN = (int16_t)lroundf(powf(r, WINDOW) * 32768.0f);
+
+    reset();
+  }
+
+  void reset(void)
+  {
+    memset(_history, 0, sizeof(_history));
+    memset(_re, 0, sizeof(_re));
+    memset(_im, 0, sizeof(_im));
+    _position = 0;
+    _filled = 0;
+    _samples = 0;
+    _estimatedAt = 0xFFFFFFFF;
+  }
+
+  //Call with every AC (DC removed) sample
+  void update(int16_t ac)
+  {
+    int32_t oldest = _history[_position];
+    _history[_position] = ac;
+    if (++_position == WINDOW) _position = 0;
+    if (_filled < WINDOW) _filled++;
+    _samples++;
+
+    //The oldest sample has decayed by r^WINDOW by the time it leaves
+    int32_t delta = ac - ((oldest * _rN + 16384) >> 15);
+
+    for (uint16_t b = 0 ; b < BINS ; b++)
+    {
+      int32_t re = _re[b] + delta;
+      int32_t im = _im[b];
+      _re[b] = (int32_t)(((int64_t)re * _cos[b] - (int64_t)im * _sin[b] + 16384) >> 15);
+      _im[b] = (int32_t)(((int64_t)re * _sin[b] + (int64_t)im * _cos[b] + 16384) >> 15);
+    }
+  }
+
+  void update(const PPGChannel &channel) { update(channel.getFilteredAC()); }
+
+  float getHeartRate(void) { estimate(); return (_bpm); } //Beats per minute, 0 until WINDOW samples have been seen
+  uint8_t getConfidence(void) { estimate(); return (_confidence); } //Percent of the band's power at the peak
+  bool isValid(uint8_t minConfidence = 40) { estimate(); return (_bpm > 0 && _confidence >= minConfidence); }
+
+ private:
+  int16_t _cos[BINS];
+  int16_t _sin[BINS];
+  int16_t _rN;
+
+  int32_t _re[BINS];
+  int32_t _im[BINS];
+
+  int16_t _history[WINDOW];
+  uint16_t _position;
+  uint16_t _filled;
+  uint32_t _samples;
+
+  uint32_t _estimatedAt; //_samples when _bpm and _confidence were worked out
+  float _bpm;
+  uint8_t _confidence;
+
+  void estimate(void)
+  {
+    if (_estimatedAt == _samples) return;
+    _estimatedAt = _samples;
+    _bpm = 0;
+    _confidence = 0;
+    if (_filled < WINDOW) return;
+
+    //Hann windowed power of each bin in the band
+    float power[BINS - 2];
+    float total = 0;
+    uint16_t peak = 0;
+    for (uint16_t b = 1 ; b < BINS - 1 ; b++)
+    {
+      float re = 0.5f * _re[b] - 0.25f * ((float)_re[b - 1] + _re[b + 1]);
+      float im = 0.5f * _im[b] - 0.25f * ((float)_im[b - 1] + _im[b + 1]);
+      power[b - 1] = re * re + im * im;
+      total += power[b - 1];
+      if (power[b - 1] > power[peak]) peak = b - 1;
+    }
+    if (total <= 0) return;
+
+    //Prefer half the frequency if it is at least half the amplitude
+    uint16_t bin = LOW_BIN + peak;
+    uint16_t half = (bin + 1) / 2;
+    if (half > LOW_BIN)
+    {
+      uint16_t h = half - LOW_BIN;
+      if (h > 0 && power[h - 1] > power[h]) h--;
+      if (h + 1 < BINS - 2 && power[h + 1] > power[h]) h++;
+      if (h < peak && power[h] * 4 >= power[peak]) peak = h;
+    }
+
+    //Fit a parabola through the log power of the peak and its neighbours, which suits the Hann window's shape
+    float offset = 0;
+    if (peak > 0 && peak < BINS - 3)
+    {
+      float before = logf(power[peak - 1] + 1);
+      float centre = logf(power[peak] + 1);
+      float after = logf(power[peak + 1] + 1);
+      float curve = before - 2 * centre + after;
+      if (curve < 0) offset = 0.5f * (before - after) / curve;
+    }
+
+    float near = power[peak];
+    if (peak > 0) near += power[peak - 1];
+    if (peak < BINS - 3) near += power[peak + 1];
+    _confidence = (uint8_t)(100.0f * near / total + 0.5f);
+
+    _bpm = (LOW_BIN + peak + offset) * 60.0f * FREQ / WINDOW;
+  }
+};
@@ -60,6 +60,39 @@
 #include "Arduino.h"
 #include "spo2_algorithm.h"
 
+//uch_spo2_table[n] is the calibration curve at ratio n/100, computed by the compiler, 8 entries per row
+#define MAXIM_SPO2_ROW(n) maxim_spo2_table_entry(n), maxim_spo2_table_entry(n + 1), maxim_spo2_table_entry(n + 2), \
+  maxim_spo2_table_entry(n + 3), maxim_spo2_table_entry(n + 4), maxim_spo2_table_entry(n + 5), \
+  maxim_spo2_table_entry(n + 6), maxim_spo2_table_entry(n + 7)
+
+static_assert(MAXIM_SPO2_TABLE_SIZE == 23 * 8, "uch_spo2_table rows must cover the table");
+
+const uint8_t uch_spo2_table[MAXIM_SPO2_TABLE_SIZE] FLASH_TABLE = {
+  MAXIM_SPO2_ROW(0),
+  MAXIM_SPO2_ROW(8),
+  MAXIM_SPO2_ROW(16),
+  MAXIM_SPO2_ROW(24),
+  MAXIM_SPO2_ROW(32),
+  MAXIM_SPO2_ROW(40),
+  MAXIM_SPO2_ROW(48),
+  MAXIM_SPO2_ROW(56),
+  MAXIM_SPO2_ROW(64),
+  MAXIM_SPO2_ROW(72),
+  MAXIM_SPO2_ROW(80),
+  MAXIM_SPO2_ROW(88),
+  MAXIM_SPO2_ROW(96),
+  MAXIM_SPO2_ROW(104),
+  MAXIM_SPO2_ROW(112),
+  MAXIM_SPO2_ROW(120),
+  MAXIM_SPO2_ROW(128),
+  MAXIM_SPO2_ROW(136),
+  MAXIM_SPO2_ROW(144),
+  MAXIM_SPO2_ROW(152),
+  MAXIM_SPO2_ROW(160),
+  MAXIM_SPO2_ROW(168),
+  MAXIM_SPO2_ROW(176)
+};
+
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
 //To solve this problem, 16-bit MSB of the sampled data will be truncated.  Samples become 16-bit data.
@@ -75,6 +108,7 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
 *               By detecting  peaks of PPG cycle and corresponding AC/DC of red/infra-red signal, the an_ratio for the SPO2 is computed.
 *               Since this algorithm is aiming for Arm M0/M3. formaula for SPO2 did not achieve the accuracy due to register overflow.
 *               Thus, accurate SPO2 is precalculated and save longo uch_spo2_table[] per each an_ratio.
+*               This is the FreqS/BUFFER_SIZE instance of the templated version in spo2_algorithm.h.
 *
 * \param[in]    *pun_ir_buffer           - IR sensor data buffer
 * \param[in]    n_ir_buffer_length      - IR sensor data buffer length
@@ -87,126 +121,10 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
 * \retval       None
 */
 {
-  uint32_t un_ir_mean;
-  int32_t k, n_i_ratio_count;
-  int32_t i, n_exact_ir_valley_locs_count, n_middle_idx;
-  int32_t n_th1, n_npks;   
-  int32_t an_ir_valley_locs[15] ;
-  int32_t n_peak_interval_sum;
-  
-  int32_t n_y_ac, n_x_ac;
-  int32_t n_spo2_calc; 
-  int32_t n_y_dc_max, n_x_dc_max; 
-  int32_t n_y_dc_max_idx = 0;
-  int32_t n_x_dc_max_idx = 0; 
-  int32_t an_ratio[5], n_ratio_average; 
-  int32_t n_nume, n_denom ;
-
-  // calculates DC mean and subtract DC from ir
-  un_ir_mean =0; 
-  for (k=0 ; k<n_ir_buffer_length ; k++ ) un_ir_mean += pun_ir_buffer[k] ;
-  un_ir_mean =un_ir_mean/n_ir_buffer_length ;
-    
-  // remove DC and invert signal so that we can use peak detector as valley detector
-  for (k=0 ; k<n_ir_buffer_length ; k++ )  
-    an_x[k] = -1*(pun_ir_buffer[k] - un_ir_mean) ; 
-    
-  // 4 pt Moving Average
-  for(k=0; k< BUFFER_SIZE-MA4_SIZE; k++){
-    an_x[k]=( an_x[k]+an_x[k+1]+ an_x[k+2]+ an_x[k+3])/(int)4;        
-  }
-  // calculate threshold  
-  n_th1=0; 
-  for ( k=0 ; k<BUFFER_SIZE ;k++){
-    n_th1 +=  an_x[k];
-  }
-  n_th1=  n_th1/ ( BUFFER_SIZE);
-  if( n_th1<30) n_th1=30; // min allowed
-  if( n_th1>60) n_th1=60; // max allowed
-
-  for ( k=0 ; k<15;k++) an_ir_valley_locs[k]=0;
-  // since we flipped signal, we use peak detector as valley detector
-  maxim_find_peaks( an_ir_valley_locs, &n_npks, an_x, BUFFER_SIZE, n_th1, 4, 15 );//peak_height, peak_distance, max_num_peaks 
-  n_peak_interval_sum =0;
-  if (n_npks>=2){
-    for (k=1; k<n_npks; k++) n_peak_interval_sum += (an_ir_valley_locs[k] -an_ir_valley_locs[k -1] ) ;
-    n_peak_interval_sum =n_peak_interval_sum/(n_npks-1);
-    *pn_heart_rate =(int32_t)( (FreqS*60)/ n_peak_interval_sum );
-    *pch_hr_valid  = 1;
-  }
-  else  { 
-    *pn_heart_rate = -999; // unable to calculate because # of peaks are too small
-    *pch_hr_valid  = 0;
-  }
-
-  //  load raw value again for SPO2 calculation : RED(=y) and IR(=X)
-  for (k=0 ; k<n_ir_buffer_length ; k++ )  {
-      an_x[k] =  pun_ir_buffer[k] ; 
-      an_y[k] =  pun_red_buffer[k] ; 
-  }
-
-  // find precise min near an_ir_valley_locs
-  n_exact_ir_valley_locs_count =n_npks; 
-  
-  //using exact_ir_valley_locs , find ir-red DC andir-red AC for SPO2 calibration an_ratio
-  //finding AC/DC maximum of raw
-
-  n_ratio_average =0; 
-  n_i_ratio_count = 0; 
-  for(k=0; k< 5; k++) an_ratio[k]=0;
-  for (k=0; k< n_exact_ir_valley_locs_count; k++){
-    if (an_ir_valley_locs[k] > BUFFER_SIZE ){
-      *pn_spo2 =  -999 ; // do not use SPO2 since valley loc is out of range
-      *pch_spo2_valid  = 0; 
-      return;
-    }
-  }
-  // find max between two valley locations 
-  // and use an_ratio betwen AC compoent of Ir & Red and DC compoent of Ir & Red for SPO2 
-  for (k=0; k< n_exact_ir_valley_locs_count-1; k++){
-    n_y_dc_max= -16777216 ; 
-    n_x_dc_max= -16777216; 
-    if (an_ir_valley_locs[k+1]-an_ir_valley_locs[k] >3){
-        for (i=an_ir_valley_locs[k]; i< an_ir_valley_locs[k+1]; i++){
-          if (an_x[i]> n_x_dc_max) {n_x_dc_max =an_x[i]; n_x_dc_max_idx=i;}
-          if (an_y[i]> n_y_dc_max) {n_y_dc_max =an_y[i]; n_y_dc_max_idx=i;}
-      }
-      n_y_ac= (an_y[an_ir_valley_locs[k+1]] - an_y[an_ir_valley_locs[k] ] )*(n_y_dc_max_idx -an_ir_valley_locs[k]); //red
-      n_y_ac=  an_y[an_ir_valley_locs[k]] + n_y_ac/ (an_ir_valley_locs[k+1] - an_ir_valley_locs[k])  ; 
-      n_y_ac=  an_y[n_y_dc_max_idx] - n_y_ac;    // subracting linear DC compoenents from raw 
-      n_x_ac= (an_x[an_ir_valley_locs[k+1]] - an_x[an_ir_valley_locs[k] ] )*(n_x_dc_max_idx -an_ir_valley_locs[k]); // ir
-      n_x_ac=  an_x[an_ir_valley_locs[k]] + n_x_ac/ (an_ir_valley_locs[k+1] - an_ir_valley_locs[k]); 
-      n_x_ac=  an_x[n_y_dc_max_idx] - n_x_ac;      // subracting linear DC compoenents from raw 
-      n_nume=( n_y_ac *n_x_dc_max)>>7 ; //prepare X100 to preserve floating value
-      n_denom= ( n_x_ac *n_y_dc_max)>>7;
-      if (n_denom>0  && n_i_ratio_count <5 &&  n_nume != 0)
-      {   
-        an_ratio[n_i_ratio_count]= (n_nume*100)/n_denom ; //formular is ( n_y_ac *n_x_dc_max) / ( n_x_ac *n_y_dc_max) ;
-        n_i_ratio_count++;
-      }
-    }
-  }
-  // choose median value since PPG signal may varies from beat to beat
-  maxim_sort_ascend(an_ratio, n_i_ratio_count);
-  n_middle_idx= n_i_ratio_count/2;
-
-  if (n_middle_idx >1)
-    n_ratio_average =( an_ratio[n_middle_idx-1] +an_ratio[n_middle_idx])/2; // use median
-  else
-    n_ratio_average = an_ratio[n_middle_idx ];
-
-  if( n_ratio_average>2 && n_ratio_average <184){
-    n_spo2_calc= uch_spo2_table[n_ratio_average] ;
-    *pn_spo2 = n_spo2_calc ;
-    *pch_spo2_valid  = 1;//  float_SPO2 =  -45.060*n_ratio_average* n_ratio_average/10000 + 30.354 *n_ratio_average/100 + 94.845 ;  // for comparison with table
-  }
-  else{
-    *pn_spo2 =  -999 ; // do not use SPO2 since signal an_ratio is out of range
-    *pch_spo2_valid  = 0; 
-  }
+  maxim_heart_rate_and_oxygen_saturation<FreqS, BUFFER_SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, 
+                pn_heart_rate, pch_hr_valid);
 }
 
-
 void maxim_find_peaks( int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_min_distance, int32_t n_max_num )
 /**
 * \brief        Find peaks
@@ -216,16 +134,16 @@ void maxim_find_peaks( int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32
 * \retval       None
 */
 {
-  maxim_peaks_above_min_height( pn_locs, n_npks, pn_x, n_size, n_min_height );
+  maxim_peaks_above_min_height( pn_locs, n_npks, pn_x, n_size, n_min_height, n_max_num );
   maxim_remove_close_peaks( pn_locs, n_npks, pn_x, n_min_distance );
   *n_npks = min( *n_npks, n_max_num );
 }
 
-void maxim_peaks_above_min_height( int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height )
+void maxim_peaks_above_min_height( int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_max_num )
 /**
 * \brief        Find peaks above n_min_height
 * \par          Details
-*               Find all peaks above MIN_HEIGHT
+*               Find at most n_max_num peaks above MIN_HEIGHT (pn_locs must hold n_max_num entries)
 *
 * \retval       None
 */
@@ -238,7 +156,7 @@ void maxim_peaks_above_min_height( int32_t *pn_locs, int32_t *n_npks,  int32_t
       n_width = 1;
       while (i+n_width < n_size && pn_x[i] == pn_x[i+n_width])  // find flat peaks
         n_width++;
-      if (pn_x[i] > pn_x[i+n_width] && (*n_npks) < 15 ){      // find right edge of peaks
+      if (i+n_width < n_size && pn_x[i] > pn_x[i+n_width] && (*n_npks) < n_max_num ){      // find right edge of peaks, a plateau running off the end is not one
         pn_locs[(*n_npks)++] = i;    
         // for flat peaks, peak location is left edge
         i += n_width+1;
@@ -280,6 +198,117 @@ void maxim_remove_close_peaks(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x,
   maxim_sort_ascend( pn_locs, *pn_npks );
 }
 
+void maxim_find_peaks_linear( int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_min_distance, int32_t n_max_num, int32_t *pn_scratch )
+/**
+* \brief        Find peaks in linear time
+* \par          Details
+*               Same result as maxim_find_peaks() but runs in O(n_size + n_max_num) so long windows stay affordable.
+*               pn_scratch must hold 2*n_max_num entries.
+*
+* \retval       None
+*/
+{
+  maxim_peaks_above_min_height( pn_locs, n_npks, pn_x, n_size, n_min_height, n_max_num );
+  maxim_remove_close_peaks_linear( pn_locs, n_npks, pn_x, n_min_distance, pn_scratch );
+  *n_npks = min( *n_npks, n_max_num );
+}
+
+void maxim_remove_close_peaks_linear(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x, int32_t n_min_distance, int32_t *pn_scratch)
+/**
+* \brief        Remove peaks in linear time
+* \par          Details
+*               Keeps the same peaks as maxim_remove_close_peaks(). Peaks are visited from large to small (radix sort,
+*               ties by location) and each kept peak suppresses its neighbours within MIN_DISTANCE. Kept peaks are
+*               more than MIN_DISTANCE apart so every peak is suppressed by at most two of them.
+*               pn_locs must be in ascending order (as given by maxim_peaks_above_min_height) and pn_scratch must
+*               hold 2*(*pn_npks) entries.
+*
+* \retval       None
+*/
+{
+  int32_t i, j, k, n_loc;
+  int32_t *pn_order = pn_scratch;
+
+  // lag-zero peak of autocorr is at index -1 so peaks closer than MIN_DISTANCE to the start are dropped.
+  // A suppressed peak is marked by storing its location complemented, it still bounds the neighbour search.
+  for ( i = 0; i < *pn_npks; i++ ){
+    if ( pn_locs[i] + 1 <= n_min_distance )
+      pn_locs[i] = ~pn_locs[i];
+  }
+
+  /* Order peaks from large to small */
+  maxim_sort_indices_descend_radix( pn_x, pn_locs, pn_order, pn_scratch + *pn_npks, *pn_npks );
+
+  for ( k = 0; k < *pn_npks; k++ ){
+    i = pn_order[k];
+    if ( pn_locs[i] < 0 ) continue; // already suppressed
+
+    for ( j = i-1; j >= 0; j-- ){
+      n_loc = pn_locs[j] < 0 ? ~pn_locs[j] : pn_locs[j];
+      if ( pn_locs[i] - n_loc > n_min_distance ) break;
+      pn_locs[j] = ~n_loc;
+    }
+    for ( j = i+1; j < *pn_npks; j++ ){
+      n_loc = pn_locs[j] < 0 ? ~pn_locs[j] : pn_locs[j];
+      if ( n_loc - pn_locs[i] > n_min_distance ) break;
+      pn_locs[j] = ~n_loc;
+    }
+  }
+
+  // Compact the kept peaks, they are still in ascending order
+  j = 0;
+  for ( i = 0; i < *pn_npks; i++ ){
+    if ( pn_locs[i] >= 0 )
+      pn_locs[j++] = pn_locs[i];
+  }
+  *pn_npks = j;
+}
+
+void maxim_sort_indices_descend_radix(int32_t  *pn_x, int32_t *pn_locs, int32_t *pn_order, int32_t *pn_temp, int32_t n_size)
+/**
+* \brief        Sort peaks by height
+* \par          Details
+*               Fill pn_order with positions into pn_locs ordered by descending pn_x height, ties in ascending
+*               position (the order maxim_sort_indices_descend() gives). Stable LSD radix sort, 4 bits per pass,
+*               passes where every key has the same digit are skipped. Locations may be complemented (suppressed).
+*
+* \retval       None
+*/
+{
+  int32_t i, n_shift, n_loc;
+  int32_t *pn_src = pn_order;
+  int32_t *pn_dst = pn_temp;
+  int32_t *pn_swap;
+  uint32_t un_key = 0;
+  uint8_t uch_digit;
+  int32_t an_count[16];
+
+  for (i = 0; i < n_size; i++) pn_order[i] = i;
+
+  for (n_shift = 0; n_shift < 32; n_shift += 4) {
+    for (i = 0; i < 16; i++) an_count[i] = 0;
+    for (i = 0; i < n_size; i++) {
+      n_loc = pn_locs[pn_src[i]] < 0 ? ~pn_locs[pn_src[i]] : pn_locs[pn_src[i]];
+      un_key = ~((uint32_t)pn_x[n_loc] ^ 0x80000000UL); // larger heights give smaller keys
+      an_count[(un_key >> n_shift) & 0x0F]++;
+    }
+    if (n_size == 0 || an_count[(un_key >> n_shift) & 0x0F] == n_size) continue; // digit is the same for all keys
+
+    for (i = 1; i < 16; i++) an_count[i] += an_count[i-1];
+    for (i = n_size - 1; i >= 0; i--) {
+      n_loc = pn_locs[pn_src[i]] < 0 ? ~pn_locs[pn_src[i]] : pn_locs[pn_src[i]];
+      un_key = ~((uint32_t)pn_x[n_loc] ^ 0x80000000UL);
+      uch_digit = (un_key >> n_shift) & 0x0F;
+      pn_dst[--an_count[uch_digit]] = pn_src[i];
+    }
+    pn_swap = pn_src; pn_src = pn_dst; pn_dst = pn_swap;
+  }
+
+  if (pn_src != pn_order) {
+    for (i = 0; i < n_size; i++) pn_order[i] = pn_src[i];
+  }
+}
+
 void maxim_sort_ascend(int32_t  *pn_x, int32_t n_size) 
 /**
 * \brief        Sort array
@@ -63,25 +63,69 @@
 #define SPO2_ALGORITHM_H_
 
 #include <Arduino.h>
+#include "flashTable.h"
 
 #define FreqS 25    //sampling frequency
 #define BUFFER_SIZE (FreqS * 4) 
 #define MA4_SIZE 4 // DONOT CHANGE
+
+//The algorithm was tuned for FreqS = 25 and BUFFER_SIZE = 100 (4 seconds). The constants below are derived
+//from those reference values so the same timing holds at any sample rate and window length.
+constexpr int32_t maxim_spo2_peak_distance(int32_t n_freq)      //min samples between valleys (160ms, 4 @ 25sps)
+{ return ((4 * n_freq + 12) / 25) < 1 ? 1 : ((4 * n_freq + 12) / 25); }
+constexpr int32_t maxim_spo2_min_valley_spacing(int32_t n_freq) //min valley spacing used for a ratio (120ms, 3 @ 25sps)
+{ return ((3 * n_freq + 12) / 25) < 1 ? 1 : ((3 * n_freq + 12) / 25); }
+constexpr int32_t maxim_spo2_max_valleys(int32_t n_freq, int32_t n_size) //valleys kept per window (3.75/s, 15 @ 4s)
+{ return ((15 * n_size + 4 * n_freq - 1) / (4 * n_freq)) < 2 ? 2 : ((15 * n_size + 4 * n_freq - 1) / (4 * n_freq)); }
+constexpr int32_t maxim_spo2_max_ratios(int32_t n_freq, int32_t n_size)  //ratios used for the median (1.25/s, 5 @ 4s)
+{ return ((5 * n_size + 4 * n_freq - 1) / (4 * n_freq)) < 1 ? 1 : ((5 * n_size + 4 * n_freq - 1) / (4 * n_freq)); }
+
+template <int32_t FREQ, int32_t SIZE>
+struct maxim_spo2_config
+{
+  static_assert(FREQ > 0, "Sample rate must be positive");
+  static_assert(SIZE > MA4_SIZE, "Window must be longer than the moving average");
+
+  static const int32_t n_freq = FREQ;
+  static const int32_t n_buffer_size = SIZE;
+  static const int32_t n_peak_distance = maxim_spo2_peak_distance(FREQ);
+  static const int32_t n_min_valley_spacing = maxim_spo2_min_valley_spacing(FREQ);
+  static const int32_t n_max_valleys = maxim_spo2_max_valleys(FREQ, SIZE);
+  static const int32_t n_max_ratios = maxim_spo2_max_ratios(FREQ, SIZE);
+  static const int32_t n_min_threshold = 30; //Threshold clamps are in ADC counts of the averaged signal, not time
+  static const int32_t n_max_threshold = 60;
+};
 //#define min(x,y) ((x) < (y) ? (x) : (y)) //Defined in Arduino.h
 
-//uch_spo2_table is approximated as  -45.060*ratioAverage* ratioAverage + 30.354 *ratioAverage + 94.845 ;
-const uint8_t uch_spo2_table[184]={ 95, 95, 95, 96, 96, 96, 97, 97, 97, 97, 97, 98, 98, 98, 98, 98, 99, 99, 99, 99, 
-              99, 99, 99, 99, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 
-              100, 100, 100, 100, 99, 99, 99, 99, 99, 99, 99, 99, 98, 98, 98, 98, 98, 98, 97, 97, 
-              97, 97, 96, 96, 96, 96, 95, 95, 95, 94, 94, 94, 93, 93, 93, 92, 92, 92, 91, 91, 
-              90, 90, 89, 89, 89, 88, 88, 87, 87, 86, 86, 85, 85, 84, 84, 83, 82, 82, 81, 81, 
-              80, 80, 79, 78, 78, 77, 76, 76, 75, 74, 74, 73, 72, 72, 71, 70, 69, 69, 68, 67, 
-              66, 66, 65, 64, 63, 62, 62, 61, 60, 59, 58, 57, 56, 56, 55, 54, 53, 52, 51, 50, 
-              49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 31, 30, 29, 
-              28, 27, 26, 25, 23, 22, 21, 20, 19, 17, 16, 15, 14, 12, 11, 10, 9, 7, 6, 5, 
-              3, 2, 1 } ;
-static  int32_t an_x[ BUFFER_SIZE]; //ir
-static  int32_t an_y[ BUFFER_SIZE]; //red
+//SpO2 calibration curve, SpO2 = A*ratio*ratio + B*ratio + C with ratio = red/IR AC/DC ratio.
+//The coefficients are in thousandths. The defaults are Maxim's -45.060, 30.354 and 94.845.
+//Build with for example -DMAXIM_SPO2_CAL_A=-45060 -DMAXIM_SPO2_CAL_B=30354 -DMAXIM_SPO2_CAL_C=94845
+//to use a device's own calibration. uch_spo2_table is generated from them at compile time.
+#ifndef MAXIM_SPO2_CAL_A
+#define MAXIM_SPO2_CAL_A -45060
+#endif
+#ifndef MAXIM_SPO2_CAL_B
+#define MAXIM_SPO2_CAL_B 30354
+#endif
+#ifndef MAXIM_SPO2_CAL_C
+#define MAXIM_SPO2_CAL_C 94845
+#endif
+
+#define MAXIM_SPO2_TABLE_SIZE 184 //n_ratio_average is 100*ratio, the table covers ratio 0 to 1.83
+
+//Table entry for n_ratio (100*ratio): the curve rounded to a whole percent and clamped to 0..255
+constexpr int64_t maxim_spo2_curve(int64_t n_a, int64_t n_b, int64_t n_c, int64_t n_ratio)
+{ return ((n_a * n_ratio * n_ratio + n_b * n_ratio * 100 + n_c * 10000 + 5000000) / 10000000); }
+constexpr uint8_t maxim_spo2_table_entry(int32_t n_ratio)
+{
+  return (maxim_spo2_curve(MAXIM_SPO2_CAL_A, MAXIM_SPO2_CAL_B, MAXIM_SPO2_CAL_C, n_ratio) < 0 ? 0 :
+          maxim_spo2_curve(MAXIM_SPO2_CAL_A, MAXIM_SPO2_CAL_B, MAXIM_SPO2_CAL_C, n_ratio) > 255 ? 255 :
+          (uint8_t)maxim_spo2_curve(MAXIM_SPO2_CAL_A, MAXIM_SPO2_CAL_B, MAXIM_SPO2_CAL_C, n_ratio));
+}
+
+//Defined once in spo2_algorithm.cpp, in program memory on AVR. Read it with maxim_spo2_table().
+extern const uint8_t uch_spo2_table[MAXIM_SPO2_TABLE_SIZE];
+inline uint8_t maxim_spo2_table(int32_t n_ratio) { return (readTable8(&uch_spo2_table[n_ratio])); }
 
 
 #if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
@@ -93,10 +137,186 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
 #endif
 
 void maxim_find_peaks(int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_min_distance, int32_t n_max_num);
-void maxim_peaks_above_min_height(int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height);
+void maxim_peaks_above_min_height(int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_max_num = 15);
 void maxim_remove_close_peaks(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x, int32_t n_min_distance);
+void maxim_find_peaks_linear(int32_t *pn_locs, int32_t *n_npks,  int32_t  *pn_x, int32_t n_size, int32_t n_min_height, int32_t n_min_distance, int32_t n_max_num, int32_t *pn_scratch);
+void maxim_remove_close_peaks_linear(int32_t *pn_locs, int32_t *pn_npks, int32_t *pn_x, int32_t n_min_distance, int32_t *pn_scratch);
+void maxim_sort_indices_descend_radix(int32_t  *pn_x, int32_t *pn_locs, int32_t *pn_order, int32_t *pn_temp, int32_t n_size);
 void maxim_sort_ascend(int32_t  *pn_x, int32_t n_size);
 void maxim_sort_indices_descend(int32_t  *pn_x, int32_t *pn_indx, int32_t n_size);
 
+//Work arrays of one SpO2 calculation. Give each thread its own to run calculations in parallel.
+template <int32_t SIZE>
+struct maxim_spo2_workspace
+{
+  int32_t an_x[SIZE]; //ir
+};
+
+//Output of one SpO2/HR window, as passed to callbacks and collected by BatchAnalysis
+struct SpO2Reading
+{
+  uint32_t sample; //Index of the first sample in the window
+  int32_t spo2;
+  int8_t spo2Valid;
+  int32_t heartRate;
+  int8_t heartRateValid;
+};
+
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+void maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid, 
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid, maxim_spo2_workspace<SIZE> *p_workspace, uint32_t un_ir_mean)
+/**
+* \brief        Calculate the heart rate and SpO2 level for a FREQ sps, SIZE sample window
+* \par          Details
+*               Same algorithm as the FreqS/BUFFER_SIZE version. Peak distance, valley and ratio counts are
+*               scaled from the 25sps/100 sample reference at compile time (see maxim_spo2_config).
+*               Example: maxim_heart_rate_and_oxygen_saturation<50, 200>(irBuffer, 200, redBuffer, ...)
+*               Work arrays are taken from *p_workspace, the overload without it shares one per FREQ/SIZE.
+*               un_ir_mean is the mean of the IR window when a preprocessing stage already tracks it
+*               (PPGChannel::getWindowMean()), the overloads without it calculate it.
+*
+* \retval       None
+*/
+{
+  typedef maxim_spo2_config<FREQ, SIZE> config;
+
+  int32_t *an_x = p_workspace->an_x; //ir
+
+  int32_t k, n_i_ratio_count;
+  int32_t i, n_exact_ir_valley_locs_count, n_middle_idx;
+  int32_t n_th1, n_npks;   
+  int32_t an_ir_valley_locs[config::n_max_valleys] ;
+  int32_t an_peak_scratch[2 * config::n_max_valleys] ;
+  int32_t n_peak_interval_sum;
+  
+  int32_t n_y_ac, n_x_ac;
+  int32_t n_spo2_calc; 
+  int32_t n_y_dc_max, n_x_dc_max; 
+  int32_t n_y_dc_max_idx = 0;
+  int32_t n_x_dc_max_idx = 0; 
+  int32_t an_ratio[config::n_max_ratios], n_ratio_average; 
+  int32_t n_nume, n_denom ;
+
+  // remove DC and invert signal so that we can use peak detector as valley detector
+  for (k=0 ; k<n_ir_buffer_length ; k++ )  
+    an_x[k] = -1*(pun_ir_buffer[k] - un_ir_mean) ; 
+    
+  // 4 pt Moving Average
+  for(k=0; k< SIZE-MA4_SIZE; k++){
+    an_x[k]=( an_x[k]+an_x[k+1]+ an_x[k+2]+ an_x[k+3])/(int)4;        
+  }
+  // calculate threshold  
+  n_th1=0; 
+  for ( k=0 ; k<SIZE ;k++){
+    n_th1 +=  an_x[k];
+  }
+  n_th1=  n_th1/ ( SIZE);
+  if( n_th1<config::n_min_threshold) n_th1=config::n_min_threshold; // min allowed
+  if( n_th1>config::n_max_threshold) n_th1=config::n_max_threshold; // max allowed
+
+  for ( k=0 ; k<config::n_max_valleys;k++) an_ir_valley_locs[k]=0;
+  // since we flipped signal, we use peak detector as valley detector
+  maxim_find_peaks_linear( an_ir_valley_locs, &n_npks, an_x, SIZE, n_th1, config::n_peak_distance, config::n_max_valleys, an_peak_scratch );//peak_height, peak_distance, max_num_peaks 
+  n_peak_interval_sum =0;
+  if (n_npks>=2){
+    for (k=1; k<n_npks; k++) n_peak_interval_sum += (an_ir_valley_locs[k] -an_ir_valley_locs[k -1] ) ;
+    n_peak_interval_sum =n_peak_interval_sum/(n_npks-1);
+    *pn_heart_rate =(int32_t)( (FREQ*60)/ n_peak_interval_sum );
+    *pch_hr_valid  = 1;
+  }
+  else  { 
+    *pn_heart_rate = -999; // unable to calculate because # of peaks are too small
+    *pch_hr_valid  = 0;
+  }
+
+  //  raw values for SPO2 calculation : RED(=y) and IR(=X), read in place rather than reloaded
+#define IR_RAW(k)  ((int32_t)pun_ir_buffer[k])
+#define RED_RAW(k) ((int32_t)pun_red_buffer[k])
+
+  // find precise min near an_ir_valley_locs
+  n_exact_ir_valley_locs_count =n_npks; 
+  
+  //using exact_ir_valley_locs , find ir-red DC andir-red AC for SPO2 calibration an_ratio
+  //finding AC/DC maximum of raw
+
+  n_ratio_average =0; 
+  n_i_ratio_count = 0; 
+  for(k=0; k< config::n_max_ratios; k++) an_ratio[k]=0;
+  for (k=0; k< n_exact_ir_valley_locs_count; k++){
+    if (an_ir_valley_locs[k] >= n_ir_buffer_length ){
+      *pn_spo2 =  -999 ; // do not use SPO2 since valley loc is out of range
+      *pch_spo2_valid  = 0; 
+      return;
+    }
+  }
+  // find max between two valley locations 
+  // and use an_ratio betwen AC compoent of Ir & Red and DC compoent of Ir & Red for SPO2 
+  for (k=0; k< n_exact_ir_valley_locs_count-1; k++){
+    n_y_dc_max= -16777216 ; 
+    n_x_dc_max= -16777216; 
+    if (an_ir_valley_locs[k+1]-an_ir_valley_locs[k] >config::n_min_valley_spacing){
+        for (i=an_ir_valley_locs[k]; i< an_ir_valley_locs[k+1]; i++){
+          if (IR_RAW(i)> n_x_dc_max) {n_x_dc_max =IR_RAW(i); n_x_dc_max_idx=i;}
+          if (RED_RAW(i)> n_y_dc_max) {n_y_dc_max =RED_RAW(i); n_y_dc_max_idx=i;}
+      }
+      n_y_ac= (RED_RAW(an_ir_valley_locs[k+1]) - RED_RAW(an_ir_valley_locs[k] ) )*(n_y_dc_max_idx -an_ir_valley_locs[k]); //red
+      n_y_ac=  RED_RAW(an_ir_valley_locs[k]) + n_y_ac/ (an_ir_valley_locs[k+1] - an_ir_valley_locs[k])  ; 
+      n_y_ac=  RED_RAW(n_y_dc_max_idx) - n_y_ac;    // subracting linear DC compoenents from raw 
+      n_x_ac= (IR_RAW(an_ir_valley_locs[k+1]) - IR_RAW(an_ir_valley_locs[k] ) )*(n_x_dc_max_idx -an_ir_valley_locs[k]); // ir
+      n_x_ac=  IR_RAW(an_ir_valley_locs[k]) + n_x_ac/ (an_ir_valley_locs[k+1] - an_ir_valley_locs[k]); 
+      n_x_ac=  IR_RAW(n_y_dc_max_idx) - n_x_ac;      // subracting linear DC compoenents from raw 
+      n_nume=( n_y_ac *n_x_dc_max)>>7 ; //prepare X100 to preserve floating value
+      n_denom= ( n_x_ac *n_y_dc_max)>>7;
+      if (n_denom>0  && n_i_ratio_count <config::n_max_ratios &&  n_nume != 0)
+      {   
+        an_ratio[n_i_ratio_count]= (n_nume*100)/n_denom ; //formular is ( n_y_ac *n_x_dc_max) / ( n_x_ac *n_y_dc_max) ;
+        n_i_ratio_count++;
+      }
+    }
+  }
+  // choose median value since PPG signal may varies from beat to beat
+  maxim_sort_ascend(an_ratio, n_i_ratio_count);
+  n_middle_idx= n_i_ratio_count/2;
+
+  if (n_middle_idx >1)
+    n_ratio_average =( an_ratio[n_middle_idx-1] +an_ratio[n_middle_idx])/2; // use median
+  else
+    n_ratio_average = an_ratio[n_middle_idx ];
+
+  if( n_ratio_average>2 && n_ratio_average <MAXIM_SPO2_TABLE_SIZE){
+    n_spo2_calc= maxim_spo2_table(n_ratio_average) ;
+    *pn_spo2 = n_spo2_calc ;
+    *pch_spo2_valid  = 1;//  float_SPO2 =  -45.060*n_ratio_average* n_ratio_average/10000 + 30.354 *n_ratio_average/100 + 94.845 ;  // for comparison with table
+  }
+  else{
+    *pn_spo2 =  -999 ; // do not use SPO2 since signal an_ratio is out of range
+    *pch_spo2_valid  = 0; 
+  }
+#undef IR_RAW
+#undef RED_RAW
+}
+
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+void maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid, 
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid, maxim_spo2_workspace<SIZE> *p_workspace)
+{
+  // calculates DC mean
+  uint32_t un_ir_mean =0; 
+  for (int32_t k=0 ; k<n_ir_buffer_length ; k++ ) un_ir_mean += pun_ir_buffer[k] ;
+  un_ir_mean =un_ir_mean/n_ir_buffer_length ;
+
+  maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, 
+                pn_heart_rate, pch_hr_valid, p_workspace, un_ir_mean);
+}
+
+template <int32_t FREQ, int32_t SIZE, typename SAMPLE>
+void maxim_heart_rate_and_oxygen_saturation(SAMPLE *pun_ir_buffer, int32_t n_ir_buffer_length, SAMPLE *pun_red_buffer, int32_t *pn_spo2, int8_t *pch_spo2_valid, 
+                int32_t *pn_heart_rate, int8_t *pch_hr_valid)
+{
+  static maxim_spo2_workspace<SIZE> workspace;
+  maxim_heart_rate_and_oxygen_saturation<FREQ, SIZE>(pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, 
+                pn_heart_rate, pch_hr_valid, &workspace);
+}
+
 #endif /* ALGORITHM_H_ */
 
@@ -0,0 +1,28 @@
+/*
+ Lock Free Single Producer, Single Consumer Index Access
+ SparkFun Electronics
+
+ For a ring where one side (for example check() in an interrupt) pushes, the
+ other (loop()) pops, and neither ever waits for or locks out the other. Each
+ index is only written by its own side:
+
+  - The producer writes the element, then publishes head with a release store
+  - The consumer reads head with an acquire load, reads the elements, then
+    hands the space back by publishing tail with a release store
+
+ Release/acquire keeps the element writes and the index update in order on
+ both Cortex-M (a DMB where the core needs one) and x86, and stops the compiler
+ from caching or reordering them on 8-bit parts. Keep the indexes to single
+ bytes so every load and store is atomic on AVR too. The sense buffer in
+ MAX30105.h is the ring these are used for.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+//Index loads and stores shared with the other side
+template <typename T>
+inline T spsc_load_acquire(const T *index) { return (__atomic_load_n(index, __ATOMIC_ACQUIRE)); }
+template <typename T>
+inline void spsc_store_release(T *index, T value) { __atomic_store_n(index, value, __ATOMIC_RELEASE); }